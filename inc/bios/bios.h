@@ -51,6 +51,8 @@ typedef struct {
         };
     };
     uint32_t eflags;   /**< EFLAGS register (lower 32 bits) */
+    uint16_t ds;       /**< DS segment register, input only */
+    uint16_t es;       /**< ES segment register, input only */
 } bios_call_t;
 
 #define EFLAGS_CF (1U <<  0) /**< Carry flag */
@@ -64,10 +66,16 @@ typedef struct {
 #define EFLAGS_OF (1U << 11) /**< Overflow flag */
 #define EFLAGS_NT (1U << 14) /**< Nested task flag */
 
+/**
+ * @brief BIOS drive ID that the system was booted from, as passed in by stage 1
+ */
+extern uint8_t bios_boot_drive;
+
 /**
  * @brief Makes a call to a BIOS interrupt in real mode
  *
- * @note All segments are set to 0 prior to making tha call
+ * @note All segments apart from DS and ES are set to 0 prior to making the
+ * call. DS and ES are taken from the call parameters, and are not returned.
  *
  * @param call Pointer of parameters to use for interrupt call
  */
@@ -20,6 +20,8 @@ typedef struct config_data_struct {
     uint8_t               config_version; /**< Config version */
     char                 *kernel_path;    /**< Path to kernel file. */
     char                 *kernel_cmdline; /**< Commandline to pass to kernel. */
+    char                 *ramdisk_path;   /**< Path to FAT image to use as the default filesystem, or NULL. */
+    char                 *remote_port;    /**< Serial port serving a FAT image to use as the default filesystem, or NULL. */
 
     unsigned              module_count;   /**< Number of modules to be loaded. */
     config_data_module_t *modules;        /**< Pointer to array of module data. */
@@ -67,7 +67,25 @@ struct exec_hand_struct {
 int exec_open(exec_hand_t *exec, file_hand_t *file);
 
 /**
- * @brief Execute loaded binary.
+ * @brief Load executable into memory
+ *
+ * @param exec Exec handle
+ * @return 0 on success, < 0 on failure.
+ */
+int exec_load(exec_hand_t *exec);
+
+/**
+ * @brief Load modules listed in the configuration, following the loaded
+ * executable in memory
+ *
+ * @param exec Exec handle, after exec_load()
+ * @param cfg Configuration
+ * @return 0 on success, < 0 on failure.
+ */
+int exec_load_modules(exec_hand_t *exec, config_data_t *cfg);
+
+/**
+ * @brief Execute loaded binary, after exec_load() and exec_load_modules().
  *
  * @param exec Exec handle
  * @param cfg Configuration
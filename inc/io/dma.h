@@ -0,0 +1,41 @@
+#ifndef LBOOT_IO_DMA_H
+#define LBOOT_IO_DMA_H
+
+#include <stdint.h>
+
+#define DMA_LIMIT    (0x1000000) /**< ISA DMA can only address the first 16 MiB */
+#define DMA_BOUNDARY (0x10000)   /**< ISA DMA transfers cannot cross a 64 KiB boundary */
+
+#define DMA_MODE_XFER_VERIFY (0U << 2) /**< Perform no memory accesses */
+#define DMA_MODE_XFER_WRITE  (1U << 2) /**< Transfer from device to memory */
+#define DMA_MODE_XFER_READ   (2U << 2) /**< Transfer from memory to device */
+#define DMA_MODE_AUTOINIT    (1U << 4) /**< Re-arm channel after transfer completes */
+#define DMA_MODE_DECREMENT   (1U << 5) /**< Decrement address rather than increment */
+#define DMA_MODE_DEMAND      (0U << 6) /**< Demand transfer mode */
+#define DMA_MODE_SINGLE      (1U << 6) /**< Single transfer mode */
+#define DMA_MODE_BLOCK       (2U << 6) /**< Block transfer mode */
+
+/* 8-bit (master) controller registers */
+#define DMA_REG_ADDR(C)  (((C) * 2) + 0) /**< Start address of channel C */
+#define DMA_REG_COUNT(C) (((C) * 2) + 1) /**< Transfer count of channel C */
+#define DMA_REG_STATUS   (0x08)          /**< Status register */
+#define DMA_REG_MASK     (0x0A)          /**< Single channel mask register */
+#define DMA_REG_MODE     (0x0B)          /**< Mode register */
+#define DMA_REG_FLIPFLOP (0x0C)          /**< Flip-flop reset register */
+
+#define DMA_MASK_SET (1U << 2) /**< Mask (disable) the selected channel */
+
+/**
+ * @brief Program an 8-bit ISA DMA channel for a single transfer
+ *
+ * @param channel DMA channel, 0-3
+ * @param buff Memory to transfer to/from, must be below DMA_LIMIT and not
+ * cross a DMA_BOUNDARY
+ * @param size Number of bytes to transfer, 1-65536
+ * @param mode Transfer mode, see `DMA_MODE_*`
+ * @return 0 on success, < 0 on error
+ */
+int dma_setup(uint8_t channel, void *buff, uint32_t size, uint8_t mode);
+
+#endif
+
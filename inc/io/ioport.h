@@ -73,5 +73,16 @@ static inline uint32_t inl(uint16_t port) {
         return ret;
 }
 
+/**
+ * \brief Read a string of words from a port.
+ * Reads count words from a port into a buffer, using `rep insw`.
+ * @param port the port the words will be taken from
+ * @param buff the buffer to store the words into
+ * @param count the number of words to read
+ */
+static inline void insw(uint16_t port, void *buff, uint32_t count) {
+        asm volatile("rep insw" : "+D" (buff), "+c" (count) : "d" (port) : "memory");
+}
+
 #endif
 
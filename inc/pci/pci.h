@@ -0,0 +1,140 @@
+#ifndef LBOOT_PCI_PCI_H
+#define LBOOT_PCI_PCI_H
+
+#include <stdint.h>
+
+/**
+ * @brief Location of a PCI function, in the format used by configuration
+ * mechanism #1 (bus in bits 16-23, device in 11-15, function in 8-10)
+ */
+typedef uint32_t pci_addr_t;
+
+#define PCI_ADDR(BUS, DEV, FUNC) (((pci_addr_t)(BUS) << 16) | ((pci_addr_t)(DEV) << 11) | ((pci_addr_t)(FUNC) << 8))
+#define PCI_ADDR_BUS(A)          (((A) >> 16) & 0xFF)
+#define PCI_ADDR_DEV(A)          (((A) >> 11) & 0x1F)
+#define PCI_ADDR_FUNC(A)         (((A) >>  8) & 0x07)
+
+/**
+ * @brief Read 32-bit value from PCI configuration space
+ *
+ * @param addr PCI function
+ * @param reg Register offset, must be 4-byte aligned
+ * @return Register value
+ */
+uint32_t pci_read32(pci_addr_t addr, uint8_t reg);
+
+/**
+ * @brief Read 16-bit value from PCI configuration space
+ *
+ * @param addr PCI function
+ * @param reg Register offset, must be 2-byte aligned
+ * @return Register value
+ */
+uint16_t pci_read16(pci_addr_t addr, uint8_t reg);
+
+/**
+ * @brief Read 8-bit value from PCI configuration space
+ *
+ * @param addr PCI function
+ * @param reg Register offset
+ * @return Register value
+ */
+uint8_t pci_read8(pci_addr_t addr, uint8_t reg);
+
+/**
+ * @brief Write 32-bit value to PCI configuration space
+ *
+ * @param addr PCI function
+ * @param reg Register offset, must be 4-byte aligned
+ * @param val Value to write
+ */
+void pci_write32(pci_addr_t addr, uint8_t reg, uint32_t val);
+
+/**
+ * @brief Write 16-bit value to PCI configuration space
+ *
+ * @param addr PCI function
+ * @param reg Register offset, must be 2-byte aligned
+ * @param val Value to write
+ */
+void pci_write16(pci_addr_t addr, uint8_t reg, uint16_t val);
+
+/**
+ * @brief Find the nth function with the given class and subclass
+ *
+ * @param class Class code
+ * @param subclass Subclass code
+ * @param index Number of matching functions to skip
+ * @param addr Where to store location of the function
+ * @return 0 if found, else < 0
+ */
+int pci_find_class(uint8_t class, uint8_t subclass, unsigned index, pci_addr_t *addr);
+
+/**
+ * @brief Find the nth function with the given vendor and device ID
+ *
+ * @param vendor Vendor ID
+ * @param device Device ID
+ * @param index Number of matching functions to skip
+ * @param addr Where to store location of the function
+ * @return 0 if found, else < 0
+ */
+int pci_find_device(uint16_t vendor, uint16_t device, unsigned index, pci_addr_t *addr);
+
+/**
+ * @brief Get the base address of a BAR, with the flag bits removed
+ *
+ * @note Memory BARs mapped above 4 GiB cannot be used, and are reported as 0.
+ *
+ * @param addr PCI function
+ * @param bar BAR number, 0-5
+ * @return Base address, I/O port for I/O BARs, or 0 if not usable
+ */
+uint32_t pci_bar(pci_addr_t addr, uint8_t bar);
+
+/**
+ * @brief Set bits in the command register, e.g. to enable bus mastering
+ *
+ * @param addr PCI function
+ * @param flags Bits to set, see `PCI_COMMAND_*`
+ */
+void pci_enable(pci_addr_t addr, uint16_t flags);
+
+
+/*
+ * PCI configuration space
+ */
+
+#define PCI_CONFIG_ADDRESS (0xCF8) /**< Configuration mechanism #1 address port */
+#define PCI_CONFIG_DATA    (0xCFC) /**< Configuration mechanism #1 data port */
+#define PCI_CONFIG_ENABLE  (1UL << 31)
+
+#define PCI_REG_VENDOR     (0x00) /**< Vendor ID, 0xFFFF if no function present */
+#define PCI_REG_DEVICE     (0x02) /**< Device ID */
+#define PCI_REG_COMMAND    (0x04) /**< Command */
+#define PCI_REG_STATUS     (0x06) /**< Status */
+#define PCI_REG_CLASS      (0x08) /**< Revision, prog IF, subclass, class */
+#define PCI_REG_PROGIF     (0x09) /**< Programming interface */
+#define PCI_REG_SUBCLASS   (0x0A) /**< Subclass */
+#define PCI_REG_CLASSCODE  (0x0B) /**< Class */
+#define PCI_REG_HEADERTYPE (0x0E) /**< Header type, bit 7 set if multi-function */
+#define PCI_REG_BAR(N)     (0x10 + ((N) * 4)) /**< Base address registers */
+#define PCI_REG_IRQLINE    (0x3C) /**< IRQ line assigned by firmware */
+
+#define PCI_COMMAND_IO     (1U << 0) /**< Respond to I/O space accesses */
+#define PCI_COMMAND_MEMORY (1U << 1) /**< Respond to memory space accesses */
+#define PCI_COMMAND_MASTER (1U << 2) /**< Enable bus mastering */
+
+#define PCI_BAR_IO         (1U << 0) /**< BAR is in I/O space */
+#define PCI_BAR_TYPE__MSK  (0x06)    /**< Memory BAR type */
+#define PCI_BAR_TYPE_64    (0x04)    /**< 64-bit memory BAR */
+
+#define PCI_HEADERTYPE_MF  (1U << 7) /**< Device has multiple functions */
+
+#define PCI_CLASS_STORAGE         (0x01) /**< Mass storage controller */
+#define PCI_SUBCLASS_STORAGE_IDE  (0x01) /**< IDE controller */
+#define PCI_SUBCLASS_STORAGE_SATA (0x06) /**< SATA controller */
+#define PCI_SUBCLASS_STORAGE_NVM  (0x08) /**< Non-volatile memory controller */
+
+#endif
+
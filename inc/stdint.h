@@ -26,6 +26,7 @@ typedef int32_t off_t; /**< Offset. @note this will need to be increased to 64-b
 #define USHORT_MAX 65535
 
 #define INT_MAX    2147483647
+#define INT_MIN    (-INT_MAX - 1)
 #define UINT_MAX   4294967295
 
 #define LONG_MAX   9223372036854775807
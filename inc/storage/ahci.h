@@ -0,0 +1,178 @@
+#ifndef LBOOT_STORAGE_AHCI_H
+#define LBOOT_STORAGE_AHCI_H
+
+#include "storage/storage.h"
+
+#pragma pack(1)
+/**
+ * @brief AHCI command header, one per command slot in the command list
+ */
+typedef struct {
+    uint16_t flags;     /**< Command FIS length in dwords, and flags, see `AHCI_CMDHDR_*` */
+    uint16_t prdtl;     /**< Number of PRDT entries */
+    uint32_t prdbc;     /**< Bytes transferred, updated by HBA */
+    uint32_t ctba;      /**< Command table address, 128-byte aligned */
+    uint32_t ctbau;     /**< Command table address, upper 32 bits */
+    uint32_t _reserved[4];
+} storage_ahci_cmdhdr_t;
+
+#define AHCI_CMDHDR_CFL(N) ((N) & 0x1F) /**< Command FIS length, in dwords */
+#define AHCI_CMDHDR_WRITE  (1U << 6)    /**< Transfer from memory to device */
+
+/**
+ * @brief AHCI physical region descriptor table entry
+ */
+typedef struct {
+    uint32_t dba;       /**< Data base address, must be 2-byte aligned */
+    uint32_t dbau;      /**< Data base address, upper 32 bits */
+    uint32_t _reserved;
+    uint32_t dbc;       /**< Byte count - 1 in bits 0-21, interrupt on completion in bit 31 */
+} storage_ahci_prd_t;
+
+#define AHCI_PRD_MAX_SIZE (0x400000) /**< Largest region described by a single PRD entry */
+
+/**
+ * @brief AHCI command table
+ */
+typedef struct {
+    uint8_t            cfis[64];     /**< Command FIS */
+    uint8_t            acmd[16];     /**< ATAPI command */
+    uint8_t            _reserved[48];
+    storage_ahci_prd_t prdt[1];      /**< Physical region descriptor table */
+} storage_ahci_cmdtbl_t;
+
+/**
+ * @brief Host to device register FIS
+ */
+typedef struct {
+    uint8_t type;     /**< FIS type, AHCI_FIS_TYPE_H2D */
+    uint8_t flags;    /**< Port multiplier, and AHCI_FIS_H2D_CMD if this is a command */
+    uint8_t command;  /**< Command register */
+    uint8_t features; /**< Features register, bits 0-7 */
+    uint8_t lba0;     /**< LBA bits 0-7 */
+    uint8_t lba1;     /**< LBA bits 8-15 */
+    uint8_t lba2;     /**< LBA bits 16-23 */
+    uint8_t device;   /**< Device register */
+    uint8_t lba3;     /**< LBA bits 24-31 */
+    uint8_t lba4;     /**< LBA bits 32-39 */
+    uint8_t lba5;     /**< LBA bits 40-47 */
+    uint8_t features_exp; /**< Features register, bits 8-15 */
+    uint16_t count;   /**< Sector count */
+    uint8_t icc;      /**< Isochronous command completion */
+    uint8_t control;  /**< Device control register */
+    uint32_t _reserved;
+} storage_ahci_fis_h2d_t;
+
+#define AHCI_FIS_TYPE_H2D (0x27)     /**< Register FIS, host to device */
+#define AHCI_FIS_H2D_CMD  (1U << 7)  /**< FIS updates the command register */
+#pragma pack()
+
+/**
+ * @brief Data structure for holding parameters specific to the AHCI driver.
+ */
+typedef struct {
+    uintptr_t abar;           /**< HBA memory registers */
+    uintptr_t port;           /**< Port registers */
+    uint8_t   flags;          /**< Driver flags */
+#define STORAGE_AHCI_FLAG_LBA48 (1U << 0) /**< Device supports 48-bit addressing */
+#define STORAGE_AHCI_FLAG_NCQ   (1U << 1) /**< Device supports native command queueing */
+    uint8_t   n_slots;        /**< Number of command slots in use */
+
+    uint32_t  n_sectors;      /**< Number of addressable sectors */
+
+    storage_ahci_cmdhdr_t *cmdlist;    /**< Command list */
+    void                  *fis;        /**< Received FIS area */
+    storage_ahci_cmdtbl_t *cmdtbl;     /**< Command tables, one per slot */
+
+    storage_stats_t *stats; /**< Statistics of the storage handle */
+} storage_ahci_data_t;
+
+#define STORAGE_AHCI_SECTOR_SIZE  (512)   /**< Only 512-byte sectors are supported */
+#define STORAGE_AHCI_MAX_SLOTS    (32)    /**< Most command slots supported by an HBA */
+#define STORAGE_AHCI_CHUNK        (128)   /**< Sectors per command, when splitting a read across slots */
+#define STORAGE_AHCI_ATTEMPTS     (3)     /**< Attempts before giving up on a transfer */
+#define STORAGE_AHCI_CMDTBL_SIZE  (0x100) /**< Size allocated for each command table */
+
+/**
+ * @brief Setup storage handle to access a SATA disk on an AHCI controller
+ *
+ * SATA disks are enumerated in order of controller and port, skipping ATAPI
+ * and absent devices. BIOS drive 0x80 + n is assumed to be disk n.
+ *
+ * @param storage Storage handle to populate
+ * @param index Index of SATA disk to use
+ * @return int 0 on success, else < 0 if the disk was not found
+ */
+int storage_ahci_init(storage_hand_t *storage, uint8_t index);
+
+
+/*
+ * AHCI registers
+ */
+
+#define AHCI_BAR (5) /**< PCI BAR holding HBA memory registers */
+#define AHCI_PROGIF (0x01) /**< Programming interface of AHCI controllers */
+
+#define AHCI_REG(B, O) (*(volatile uint32_t *)((B) + (O)))
+
+#define AHCI_REG_CAP  (0x00) /**< Host capabilities */
+#define AHCI_REG_GHC  (0x04) /**< Global host control */
+#define AHCI_REG_IS   (0x08) /**< Interrupt status */
+#define AHCI_REG_PI   (0x0C) /**< Ports implemented */
+
+#define AHCI_CAP_NCS(C) ((((C) >> 8) & 0x1F) + 1) /**< Number of command slots */
+#define AHCI_GHC_AE     (1UL << 31)               /**< AHCI enable */
+
+#define AHCI_PORT(B, N) ((B) + 0x100 + ((N) * 0x80)) /**< Port register block */
+#define AHCI_PORTS_MAX  (32)
+
+#define AHCI_PREG_CLB  (0x00) /**< Command list base address */
+#define AHCI_PREG_CLBU (0x04) /**< Command list base address, upper 32 bits */
+#define AHCI_PREG_FB   (0x08) /**< FIS base address */
+#define AHCI_PREG_FBU  (0x0C) /**< FIS base address, upper 32 bits */
+#define AHCI_PREG_IS   (0x10) /**< Interrupt status */
+#define AHCI_PREG_IE   (0x14) /**< Interrupt enable */
+#define AHCI_PREG_CMD  (0x18) /**< Command and status */
+#define AHCI_PREG_TFD  (0x20) /**< Task file data */
+#define AHCI_PREG_SIG  (0x24) /**< Device signature */
+#define AHCI_PREG_SSTS (0x28) /**< SATA status */
+#define AHCI_PREG_SERR (0x30) /**< SATA error */
+#define AHCI_PREG_SACT (0x34) /**< SATA active, for native command queueing */
+#define AHCI_PREG_CI   (0x38) /**< Command issue */
+
+#define AHCI_PCMD_ST  (1U << 0)  /**< Start processing the command list */
+#define AHCI_PCMD_FRE (1U << 4)  /**< FIS receive enable */
+#define AHCI_PCMD_FR  (1U << 14) /**< FIS receive running */
+#define AHCI_PCMD_CR  (1U << 15) /**< Command list running */
+
+#define AHCI_PIS_TFES (1UL << 30) /**< Task file error status */
+
+#define AHCI_TFD_ERR (1U << 0) /**< Error */
+#define AHCI_TFD_DRQ (1U << 3) /**< Data request */
+#define AHCI_TFD_BSY (1U << 7) /**< Busy */
+
+#define AHCI_SSTS_DET__MSK     (0x0F)
+#define AHCI_SSTS_DET_PRESENT  (0x03) /**< Device present and communication established */
+
+#define AHCI_SIG_ATA (0x00000101) /**< Signature of an ATA device */
+
+#define AHCI_ALIGN_CMDLIST (10) /**< Command list alignment, as a power of two */
+#define AHCI_ALIGN_FIS     (8)  /**< Received FIS alignment, as a power of two */
+#define AHCI_ALIGN_CMDTBL  (7)  /**< Command table alignment, as a power of two */
+#define AHCI_FIS_SIZE      (256)
+
+#define AHCI_CMD_READ_DMA_EXT      (0x25) /**< Read DMA, 48-bit */
+#define AHCI_CMD_READ_DMA          (0xC8) /**< Read DMA, 28-bit */
+#define AHCI_CMD_READ_FPDMA_QUEUED (0x60) /**< Read, native command queueing */
+#define AHCI_CMD_IDENTIFY          (0xEC) /**< Identify device */
+
+#define AHCI_DEVICE_LBA (1U << 6) /**< LBA addressing */
+
+#define AHCI_IDENT_QUEUE_DEPTH  (75)  /**< Maximum queue depth - 1, in bits 0-4 */
+#define AHCI_IDENT_SATA_CAPS    (76)  /**< SATA capabilities, bit 8 set if NCQ supported */
+#define AHCI_IDENT_LBA28_SECTORS (60) /**< Number of 28-bit addressable sectors, 2 words */
+#define AHCI_IDENT_CMDSET2      (83)  /**< Command sets supported, bit 10 set if LBA48 supported */
+#define AHCI_IDENT_LBA48_SECTORS (100) /**< Number of 48-bit addressable sectors, 4 words */
+
+#endif
+
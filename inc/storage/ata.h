@@ -0,0 +1,137 @@
+#ifndef LBOOT_STORAGE_ATA_H
+#define LBOOT_STORAGE_ATA_H
+
+#include "storage/storage.h"
+
+#pragma pack(1)
+/**
+ * @brief Bus-master IDE physical region descriptor
+ */
+typedef struct {
+    uint32_t addr;  /**< Physical address of region, must be 2-byte aligned */
+    uint16_t size;  /**< Size of region in bytes, 0 represents 64 KiB */
+    uint16_t flags; /**< Flags, see `ATA_PRD_FLAG_*` */
+#define ATA_PRD_FLAG_EOT (1U << 15) /**< Last entry in table */
+} storage_ata_prd_t;
+#pragma pack()
+
+/**
+ * @brief Data structure for holding parameters specific to the ATA driver.
+ */
+typedef struct {
+    uint16_t base;           /**< Base I/O port of command block */
+    uint16_t ctrl;           /**< I/O port of control block (alternate status/device control) */
+    uint8_t  int_id;         /**< Interrupt ID of the channel */
+    uint8_t  drive;          /**< 0: Master, 1: Slave */
+    uint8_t  flags;          /**< Driver flags */
+#define STORAGE_ATA_FLAG_LBA48 (1U << 0) /**< Device supports 48-bit addressing */
+#define STORAGE_ATA_FLAG_DMA   (1U << 1) /**< Bus-master DMA is in use */
+    volatile uint8_t irq;    /**< Set by the channel interrupt handler */
+
+    uint16_t multiple;       /**< Sectors transferred per interrupt */
+    uint32_t n_sectors;      /**< Number of addressable sectors */
+
+    uint16_t bmide;          /**< Bus-master IDE I/O port of the channel, if STORAGE_ATA_FLAG_DMA is set */
+    storage_ata_prd_t *prdt; /**< Physical region descriptor table, if STORAGE_ATA_FLAG_DMA is set */
+
+    storage_stats_t *stats; /**< Statistics of the storage handle */
+} storage_ata_data_t;
+
+#define STORAGE_ATA_SECTOR_SIZE (512) /**< Only 512-byte sectors are supported */
+#define STORAGE_ATA_MAX_SECTORS (256) /**< Sectors per command, the most a 28-bit command can transfer */
+#define STORAGE_ATA_ATTEMPTS    (3)   /**< Attempts before giving up on a transfer */
+#define STORAGE_ATA_PRD_CNT     (4)   /**< PRD entries, enough for STORAGE_ATA_MAX_SECTORS at any alignment */
+
+/**
+ * @brief Setup storage handle to access a disk on the legacy IDE channels
+ *
+ * ATA disks are enumerated in the order primary master, primary slave,
+ * secondary master, secondary slave, skipping ATAPI and absent devices. This
+ * matches the order in which BIOSes typically assign hard disk numbers, so
+ * BIOS drive 0x80 + n is assumed to be disk n.
+ *
+ * @param storage Storage handle to populate
+ * @param index Index of ATA disk to use
+ * @return int 0 on success, else < 0 if the disk was not found
+ */
+int storage_ata_init(storage_hand_t *storage, uint8_t index);
+
+
+/*
+ * ATA registers
+ */
+
+#define ATA_PRIMARY_BASE   (0x1F0) /**< Primary channel command block */
+#define ATA_PRIMARY_CTRL   (0x3F6) /**< Primary channel control block */
+#define ATA_SECONDARY_BASE (0x170) /**< Secondary channel command block */
+#define ATA_SECONDARY_CTRL (0x376) /**< Secondary channel control block */
+
+#define ATA_REG_DATA(P)     ((P) + 0) /**< Data */
+#define ATA_REG_ERROR(P)    ((P) + 1) /**< Error (read) */
+#define ATA_REG_FEATURES(P) ((P) + 1) /**< Features (write) */
+#define ATA_REG_COUNT(P)    ((P) + 2) /**< Sector count */
+#define ATA_REG_LBA0(P)     ((P) + 3) /**< LBA bits 0-7, 24-31 */
+#define ATA_REG_LBA1(P)     ((P) + 4) /**< LBA bits 8-15, 32-39 */
+#define ATA_REG_LBA2(P)     ((P) + 5) /**< LBA bits 16-23, 40-47 */
+#define ATA_REG_DEVICE(P)   ((P) + 6) /**< Device select, LBA bits 24-27 in 28-bit mode */
+#define ATA_REG_STATUS(P)   ((P) + 7) /**< Status (read), acknowledges interrupt */
+#define ATA_REG_COMMAND(P)  ((P) + 7) /**< Command (write) */
+
+#define ATA_REG_ALTSTATUS(C) (C) /**< Alternate status (read), does not acknowledge interrupt */
+#define ATA_REG_DEVCTRL(C)   (C) /**< Device control (write) */
+
+#define ATA_STATUS_ERR  (1U << 0) /**< Error */
+#define ATA_STATUS_DRQ  (1U << 3) /**< Data request */
+#define ATA_STATUS_DF   (1U << 5) /**< Device fault */
+#define ATA_STATUS_DRDY (1U << 6) /**< Device ready */
+#define ATA_STATUS_BSY  (1U << 7) /**< Busy */
+
+#define ATA_DEVCTRL_NIEN (1U << 1) /**< Disable interrupts */
+#define ATA_DEVCTRL_SRST (1U << 2) /**< Software reset */
+
+#define ATA_DEVICE_LBA      (1U << 6)         /**< LBA addressing */
+#define ATA_DEVICE_OBS      (0xA0)            /**< Obsolete bits, set for compatibility */
+#define ATA_DEVICE_DEV(D)   ((D) << 4)        /**< Device select */
+
+#define ATA_CMD_READ_DMA          (0xC8) /**< Read DMA, 28-bit */
+#define ATA_CMD_READ_DMA_EXT      (0x25) /**< Read DMA, 48-bit */
+#define ATA_CMD_READ_SECTORS      (0x20) /**< Read sectors, PIO, 28-bit */
+#define ATA_CMD_READ_SECTORS_EXT  (0x24) /**< Read sectors, PIO, 48-bit */
+#define ATA_CMD_READ_MULTIPLE     (0xC4) /**< Read multiple, PIO, 28-bit */
+#define ATA_CMD_READ_MULTIPLE_EXT (0x29) /**< Read multiple, PIO, 48-bit */
+#define ATA_CMD_SET_MULTIPLE      (0xC6) /**< Set sectors per DRQ block for read/write multiple */
+#define ATA_CMD_IDENTIFY          (0xEC) /**< Identify device */
+
+#define ATA_IDENT_CONFIG        (0)   /**< General configuration, bit 15 clear for ATA devices */
+#define ATA_IDENT_MULTIPLE_MAX  (47)  /**< Maximum sectors per DRQ block in low byte */
+#define ATA_IDENT_CAPS          (49)  /**< Capabilities, bit 8 set if DMA supported, bit 9 set if LBA supported */
+#define ATA_IDENT_LBA28_SECTORS (60)  /**< Number of 28-bit addressable sectors, 2 words */
+#define ATA_IDENT_CMDSET2       (83)  /**< Command sets supported, bit 10 set if LBA48 supported */
+#define ATA_IDENT_LBA48_SECTORS (100) /**< Number of 48-bit addressable sectors, 4 words */
+
+
+/*
+ * Bus-master IDE registers
+ */
+
+#define ATA_BM_BAR          (4)    /**< PCI BAR holding bus-master I/O base */
+#define ATA_BM_CHANNEL_SIZE (8)    /**< Size of each channel's register block */
+
+#define ATA_BM_REG_COMMAND(P) ((P) + 0) /**< Command */
+#define ATA_BM_REG_STATUS(P)  ((P) + 2) /**< Status */
+#define ATA_BM_REG_PRDT(P)    ((P) + 4) /**< PRD table address */
+
+#define ATA_BM_CMD_START (1U << 0) /**< Start transfer */
+#define ATA_BM_CMD_READ  (1U << 3) /**< Transfer from device to memory */
+
+#define ATA_BM_STATUS_ACTIVE (1U << 0) /**< Transfer in progress */
+#define ATA_BM_STATUS_ERROR  (1U << 1) /**< Transfer failed, write 1 to clear */
+#define ATA_BM_STATUS_IRQ    (1U << 2) /**< Device raised interrupt, write 1 to clear */
+
+#define ATA_PRD_BOUNDARY (0x10000) /**< PRD regions and table may not cross a 64 KiB boundary */
+
+#define ATA_PROGIF_NATIVE(C)  (1U << ((C) * 2)) /**< Channel C is in native PCI mode */
+#define ATA_PROGIF_BUSMASTER  (1U << 7)         /**< Controller supports bus-master DMA */
+
+#endif
+
@@ -1,6 +1,7 @@
 #ifndef LBOOT_STORAGE_BIOS_H
 #define LBOOT_STORAGE_BIOS_H
 
+#include "storage/bounce.h"
 #include "storage/storage.h"
 
 /**
@@ -8,19 +9,96 @@
  */
 typedef struct {
     uint8_t  bios_id;           /**< BIOS drive ID */
+    uint8_t  flags;             /**< Driver flags */
+#define STORAGE_BIOS_FLAG_EDD (1U << 0) /**< Drive is accessed via INT 13h extensions */
 
+    uint16_t sector_size;       /**< Bytes per sector */
     uint16_t sectors_per_track; /**< Sectors per track */
     uint16_t n_heads;           /**< Number of heads */
+    uint16_t n_cylinders;       /**< Number of cylinders */
+
+    storage_bounce_t bounce;    /**< Bounce engine, allowing reads into memory the BIOS cannot reach */
+
+    /** @brief Adaptive transfer sizing state */
+    struct {
+        uint8_t cur;   /**< Current largest number of sectors per transfer */
+        uint8_t max;   /**< Largest number of sectors per transfer supported by the device */
+        uint8_t clean; /**< Number of clean transfers since the last error or size increase */
+    } xfer;
+
+    storage_stats_t *stats; /**< Statistics of the storage handle */
+
+#ifdef CONFIG_STORAGE_BIOS_TRACKCACHE
+    /**
+     * @brief Floppy track cache
+     *
+     * Reading an entire track takes roughly the same amount of time as
+     * reading a single sector from it, so whole tracks are read and kept.
+     */
+    struct {
+        void    *buff[CONFIG_STORAGE_BIOS_TRACKCACHE_CNT];  /**< Track buffers */
+        uint32_t track[CONFIG_STORAGE_BIOS_TRACKCACHE_CNT]; /**< Track held in each buffer, STORAGE_BIOS_TRACK_NONE if empty */
+#define STORAGE_BIOS_TRACK_NONE (0xFFFFFFFF)
+        uint8_t  rank[CONFIG_STORAGE_BIOS_TRACKCACHE_CNT];  /**< Rank of cache entry, representing which was last used */
+    } tcache;
+#endif
 } storage_bios_data_t;
 
+#pragma pack(1)
+/**
+ * @brief INT 13h extensions disk address packet, used by AH=42h
+ */
+typedef struct {
+    uint8_t  size;      /**< Size of packet, 0x10 */
+    uint8_t  _reserved; /**< Reserved, must be 0 */
+    uint16_t count;     /**< Number of sectors to transfer, some BIOSes limit this to 127 */
+    uint16_t offset;    /**< Offset of destination buffer */
+    uint16_t segment;   /**< Segment of destination buffer */
+    uint64_t lba;       /**< First sector to transfer */
+} storage_bios_dap_t;
+
+/**
+ * @brief INT 13h extensions drive parameters, returned by AH=48h
+ */
+typedef struct {
+    uint16_t size;          /**< Size of buffer, must be set by caller */
+    uint16_t flags;         /**< Information flags */
+    uint32_t cylinders;     /**< Number of physical cylinders */
+    uint32_t heads;         /**< Number of physical heads */
+    uint32_t sectors;       /**< Number of physical sectors per track */
+    uint64_t total_sectors; /**< Total number of sectors on the drive */
+    uint16_t sector_size;   /**< Bytes per sector */
+} storage_bios_edd_params_t;
+#pragma pack()
+
+#define STORAGE_BIOS_EDD_MAX_SECTORS (127) /**< Largest transfer supported by all EDD implementations */
+#define STORAGE_BIOS_XFER_GROW        (8) /**< Clean transfers required before doubling the transfer size */
+#define STORAGE_BIOS_ATTEMPTS         (3) /**< Single-sector attempts before giving up on a transfer */
+
 /**
  * @brief Setup storage handle from BIOS device ID
  *
+ * Floppy disks (< 0x80) are accessed via CHS, all others require INT 13h
+ * extensions to be present. Floppy geometry is taken from the FAT BPB of the
+ * inserted media if present, otherwise from INT 13h AH=08h.
+ *
  * @param storage Storage handle to populate
  * @param bios_dev BIOS device ID
  * @return int 0 on success, else < 0 on error
  */
 int storage_bios_init(storage_hand_t *storage, uint8_t bios_dev);
 
+/**
+ * @brief Read the first sector of a hard disk through INT 13h extensions
+ *
+ * Used to identify the disk the BIOS booted from, before handing it over to a
+ * native driver.
+ *
+ * @param bios_dev BIOS device ID, >= 0x80
+ * @return void* Sector contents, at least 512 bytes, to be freed by the
+ * caller, or NULL on error
+ */
+void *storage_bios_first_sector(uint8_t bios_dev);
+
 #endif
 
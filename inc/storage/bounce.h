@@ -0,0 +1,90 @@
+#ifndef LBOOT_STORAGE_BOUNCE_H
+#define LBOOT_STORAGE_BOUNCE_H
+
+#include <stdint.h>
+
+/**
+ * @brief Device transfer function used by the bounce engine
+ *
+ * @param data Device-specific data, see storage_bounce_t::data
+ * @param buff Buffer to transfer into, guaranteed to be reachable by the device
+ * @param block First block to transfer
+ * @param count Maximum number of blocks to transfer
+ * @return Number of blocks transferred, which may be less than count, or < 0
+ * on error
+ */
+typedef int (*storage_bounce_xfer_t)(void *data, void *buff, uint32_t block, uint32_t count);
+
+/**
+ * @brief Bounce buffer engine, for devices which can only transfer into a
+ * limited region of memory.
+ *
+ * Transfers into memory the device can reach are done directly, the rest are
+ * staged through the bounce region and copied to their final destination.
+ */
+typedef struct {
+    void                 *buff;       /**< Base of bounce region */
+    size_t                size;       /**< Size of bounce region, in bytes */
+    uintptr_t             limit;      /**< Direct transfers must end at or below this address */
+    uintptr_t             boundary;   /**< Direct transfers may not cross a multiple of this, 0 for no restriction */
+    uint16_t              block_size; /**< Size of a device block, in bytes */
+
+    storage_bounce_xfer_t xfer;       /**< Device transfer function */
+    void                 *data;       /**< Data passed to xfer */
+} storage_bounce_t;
+
+#define STORAGE_BOUNCE_LIMIT_REALMODE (0x100000) /**< Limit of memory addressable in real mode */
+#define STORAGE_BOUNCE_BOUNDARY_DMA   (0x10000)  /**< ISA DMA transfers cannot cross a 64 KiB boundary */
+
+/**
+ * @brief Allocate memory below 1 MiB that does not cross the given boundary
+ *
+ * @param size Number of bytes to allocate, at most 32 KiB if boundary is set
+ * @param boundary Boundary that may not be crossed, 0 for no restriction
+ * @return Pointer to allocated memory
+ */
+void *storage_bounce_alloc(size_t size, uintptr_t boundary);
+
+/**
+ * @brief Initialize bounce engine, allocating the bounce region
+ *
+ * @note xfer and data must be populated by the caller.
+ *
+ * @param bounce Bounce engine to initialize
+ * @param size Size of bounce region, in bytes
+ * @param limit Direct transfers must end at or below this address
+ * @param boundary Direct transfers may not cross a multiple of this, 0 for no restriction
+ * @param block_size Size of a device block, in bytes
+ * @return 0 on success, < 0 on failure
+ */
+int storage_bounce_init(storage_bounce_t *bounce, size_t size, uintptr_t limit, uintptr_t boundary, uint16_t block_size);
+
+/**
+ * @brief Determine where the next transfer towards a destination should go
+ *
+ * For drivers that drive the transfers themselves rather than through
+ * storage_bounce_read(). If `*xbuff` is set to the bounce region, the data
+ * must be copied to dest once transferred.
+ *
+ * @param bounce Bounce engine
+ * @param dest Final destination of the data
+ * @param count Number of blocks remaining
+ * @param xbuff Where to store the buffer to transfer into
+ * @return Number of blocks that may be transferred into `*xbuff`
+ */
+uint32_t storage_bounce_plan(const storage_bounce_t *bounce, void *dest, uint32_t count, void **xbuff);
+
+/**
+ * @brief Read blocks from device into any address, using the bounce region
+ * where required
+ *
+ * @param bounce Bounce engine
+ * @param buff Final destination of the data
+ * @param block First block to read
+ * @param count Number of blocks to read
+ * @return 0 on success, < 0 on failure
+ */
+int storage_bounce_read(storage_bounce_t *bounce, void *buff, uint32_t block, uint32_t count);
+
+#endif
+
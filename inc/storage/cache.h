@@ -0,0 +1,57 @@
+#ifndef LBOOT_STORAGE_CACHE_H
+#define LBOOT_STORAGE_CACHE_H
+
+#include <stdint.h>
+
+#include "storage/storage.h"
+
+typedef struct storage_cache_ent_struct storage_cache_ent_t;
+
+/**
+ * @brief Block cache entry
+ */
+struct storage_cache_ent_struct {
+    off_t                offset; /**< Offset of block into storage device, or < 0 if unused */
+    void                *buff;   /**< Block contents */
+    uint32_t             used;   /**< Value of storage_cache_t::clock when last accessed */
+    storage_cache_ent_t *next;   /**< Next entry in the same hash bucket */
+};
+
+#define STORAGE_CACHE_HASH_CNT (8) /**< Number of hash buckets, must be a power of two */
+
+/**
+ * @brief Cache of fixed-size blocks read from a storage device
+ */
+typedef struct {
+    storage_hand_t      *storage;    /**< Storage device blocks are read from */
+    size_t               block_size; /**< Size of a block, in bytes */
+    uint32_t             clock;      /**< Incremented on every access, for LRU replacement */
+
+    storage_cache_ent_t  ents[CONFIG_STORAGE_CACHE_CNT]; /**< Cache entries */
+    storage_cache_ent_t *hash[STORAGE_CACHE_HASH_CNT];   /**< Hash buckets, indexed by block number */
+} storage_cache_t;
+
+/**
+ * @brief Create a block cache for a storage device
+ *
+ * @param storage Storage device to cache blocks from
+ * @param block_size Size of a block, in bytes
+ * @return storage_cache_t* Block cache
+ */
+storage_cache_t *storage_cache_create(storage_hand_t *storage, size_t block_size);
+
+/**
+ * @brief Get a block, reading it from storage if it is not already cached
+ *
+ * @note The returned pointer remains valid only until the next call to
+ * storage_cache_get() on the same cache.
+ *
+ * @param cache Block cache
+ * @param offset Offset of block into storage device, in bytes, need not be
+ * aligned to the block size
+ * @return const void* Pointer to block contents, or NULL on read error
+ */
+const void *storage_cache_get(storage_cache_t *cache, off_t offset);
+
+#endif
+
@@ -0,0 +1,99 @@
+#ifndef LBOOT_STORAGE_FDC_H
+#define LBOOT_STORAGE_FDC_H
+
+#include "storage/bounce.h"
+#include "storage/storage.h"
+#include "time/time.h"
+
+/**
+ * @brief Data structure for holding parameters specific to the floppy
+ * controller driver.
+ */
+typedef struct {
+    uint8_t  drive;             /**< Drive number on controller, 0-3 */
+    uint8_t  rate;              /**< Data rate, see `FDC_CCR_RATE_*` */
+    uint8_t  cylinder;          /**< Cylinder the heads are currently over, FDC_CYLINDER_UNKNOWN if not known */
+#define FDC_CYLINDER_UNKNOWN (0xFF)
+    volatile uint8_t irq;       /**< Set by the IRQ 6 handler */
+
+    uint16_t sector_size;       /**< Bytes per sector */
+    uint16_t sectors_per_track; /**< Sectors per track */
+    uint16_t n_heads;           /**< Number of heads */
+    uint16_t n_cylinders;       /**< Number of cylinders */
+
+    storage_bounce_t bounce;    /**< Bounce engine, for memory ISA DMA cannot reach */
+
+    storage_req_t *queue;       /**< Queued requests, the first is in progress */
+    uint32_t       done;        /**< Sectors of the first request already transferred */
+    uint32_t       count;       /**< Sectors being transferred by the command in flight, 0 if idle */
+    void          *xbuff;       /**< Buffer the command in flight transfers into */
+    uint8_t        attempt;     /**< Failed attempts at the command in flight */
+    time_ticks_t   timeout;     /**< When the command in flight is considered lost */
+
+    storage_stats_t *stats; /**< Statistics of the storage handle */
+} storage_fdc_data_t;
+
+#define STORAGE_FDC_BOUNCE_SIZE (18 * 1024) /**< Size of bounce region, one 2.88 MB track */
+#define STORAGE_FDC_DMA_CHANNEL (2)         /**< ISA DMA channel used by the floppy controller */
+#define STORAGE_FDC_ATTEMPTS    (3)         /**< Attempts before giving up on a transfer */
+
+/**
+ * @brief Setup storage handle to directly access a drive on the primary
+ * floppy controller
+ *
+ * @note This takes over the floppy controller from the BIOS, so BIOS floppy
+ * services must not be used afterwards.
+ *
+ * @param storage Storage handle to populate
+ * @param drive Drive number, 0-3
+ * @return int 0 on success, else < 0 if the controller or media could not be
+ * used
+ */
+int storage_fdc_init(storage_hand_t *storage, uint8_t drive);
+
+
+/*
+ * 82077AA floppy controller registers
+ */
+
+#define FDC_BASE (0x3F0) /**< Base I/O port of primary floppy controller */
+
+#define FDC_REG_DOR  (FDC_BASE + 2) /**< Digital output register */
+#define FDC_REG_MSR  (FDC_BASE + 4) /**< Main status register (read) */
+#define FDC_REG_DSR  (FDC_BASE + 4) /**< Data rate select register (write) */
+#define FDC_REG_FIFO (FDC_BASE + 5) /**< Data FIFO */
+#define FDC_REG_DIR  (FDC_BASE + 7) /**< Digital input register (read) */
+#define FDC_REG_CCR  (FDC_BASE + 7) /**< Configuration control register (write) */
+
+#define FDC_DOR_SEL__MSK  (0x03)               /**< Drive select */
+#define FDC_DOR_NRESET    (1U << 2)            /**< Controller enabled, 0 holds it in reset */
+#define FDC_DOR_IRQDMA    (1U << 3)            /**< Enable IRQ and DMA */
+#define FDC_DOR_MOTOR(D)  (1U << (4 + (D)))    /**< Motor on for drive D */
+
+#define FDC_MSR_BUSY (1U << 4) /**< Command in progress */
+#define FDC_MSR_NDMA (1U << 5) /**< Execution phase in non-DMA mode */
+#define FDC_MSR_DIO  (1U << 6) /**< 1: Controller has data for CPU, 0: Controller expects data */
+#define FDC_MSR_RQM  (1U << 7) /**< FIFO ready for transfer */
+
+#define FDC_CCR_RATE_500K (0) /**< 500 Kbps: 1.44 MB, 1.2 MB */
+#define FDC_CCR_RATE_300K (1) /**< 300 Kbps: 360 KB in a 1.2 MB drive */
+#define FDC_CCR_RATE_250K (2) /**< 250 Kbps: 720 KB, 360 KB */
+#define FDC_CCR_RATE_1M   (3) /**< 1 Mbps: 2.88 MB */
+
+#define FDC_CMD_SPECIFY     (0x03) /**< Set drive timings */
+#define FDC_CMD_RECALIBRATE (0x07) /**< Seek to cylinder 0 */
+#define FDC_CMD_SENSEINT    (0x08) /**< Acknowledge interrupt, retrieving ST0 and cylinder */
+#define FDC_CMD_SEEK        (0x0F) /**< Seek to cylinder */
+#define FDC_CMD_READ        (0x06) /**< Read data */
+#define FDC_CMD_FLAG_SK     (0x20) /**< Skip deleted sectors */
+#define FDC_CMD_FLAG_MFM    (0x40) /**< MFM encoding */
+#define FDC_CMD_FLAG_MT     (0x80) /**< Multi-track: continue onto head 1 after the last sector on head 0 */
+
+#define FDC_ST0_IC__MSK (0xC0) /**< Interrupt code, 0 on normal termination */
+#define FDC_ST0_SE      (0x20) /**< Seek end */
+
+#define FDC_SECTOR_SIZE_512 (2) /**< Sector size code for 512-byte sectors */
+#define FDC_GAP3_LENGTH     (0x1B) /**< Gap length for 3.5" media */
+
+#endif
+
@@ -35,6 +35,16 @@ struct file_hand_struct {
      */
     ssize_t (*read)(const file_hand_t *file, void *buf, size_t sz, off_t off);
 
+    /**
+     * @brief Read a list of segments from a file, NULL if not supported
+     *
+     * @param file Handle of file to read from
+     * @param segs Segments to read, with offsets into the file
+     * @param n_segs Number of segments
+     * @return ssize_t Total number of bytes read on success, else < 0
+     */
+    ssize_t (*readv)(const file_hand_t *file, const storage_seg_t *segs, unsigned n_segs);
+
     /**
      * @brief Close a file handle, freeing any allocated memory
      *
@@ -53,6 +63,17 @@ struct file_hand_struct {
  */
 int file_open(file_hand_t *file, const char *path);
 
+/**
+ * @brief Read a list of segments from a file, using readv if the file
+ * supports it, else reading each segment in turn
+ *
+ * @param file Handle of file to read from
+ * @param segs Segments to read, with offsets into the file
+ * @param n_segs Number of segments
+ * @return ssize_t Total number of bytes read on success, else < 0
+ */
+ssize_t file_readv(const file_hand_t *file, const storage_seg_t *segs, unsigned n_segs);
+
 /**
  * @brief Sets default filesystem to search when opening a file
  *
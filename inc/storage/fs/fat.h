@@ -69,6 +69,29 @@ typedef struct {
 
     uint16_t signature;         /**< Boot sector signatore: 0x55, 0xAA */
 } fat_bootsector_t;
+#pragma pack()
+
+/**
+ * @brief Disk geometry, as described by a FAT BPB
+ */
+typedef struct {
+    uint16_t sectors_per_track; /**< Sectors per track */
+    uint16_t heads;             /**< Number of heads */
+    uint32_t total_sectors;     /**< Total number of sectors */
+} fat_geometry_t;
+
+/**
+ * @brief Extract disk geometry from a FAT bootsector, for use by storage
+ * drivers that must know the geometry of the media before reading from it
+ *
+ * @param bootsec Bootsector, as read from the first sector of the disk
+ * @param sector_size Sector size of the device
+ * @param geom Where to store the geometry
+ * @return int 0 if the bootsector contains a plausible geometry, else < 0
+ */
+int fs_fat_geometry(const fat_bootsector_t *bootsec, uint16_t sector_size, fat_geometry_t *geom);
+
+#pragma pack(1)
 
 /**
  * @brief FAT directory entry
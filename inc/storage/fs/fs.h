@@ -6,6 +6,7 @@
 typedef struct fs_hand_struct fs_hand_t;
 
 #include "storage/storage.h"
+#include "storage/cache.h"
 #include "storage/file.h"
 
 #define FS_PATHSEP '/' /**< Path separation character. */
@@ -20,6 +21,8 @@ struct fs_hand_struct {
     off_t           fs_offset; /**< Offset into storage device at which filesystem begins */
     size_t          fs_size;   /**< Size of filesystem area, in byte */
 
+    storage_cache_t *cache;    /**< Block cache, set up by the FS driver */
+
     /**
      * @brief Find a file within a directory
      *
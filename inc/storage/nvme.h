@@ -0,0 +1,143 @@
+#ifndef LBOOT_STORAGE_NVME_H
+#define LBOOT_STORAGE_NVME_H
+
+#include "storage/storage.h"
+
+#pragma pack(1)
+/**
+ * @brief NVMe submission queue entry
+ */
+typedef struct {
+    uint8_t  opcode;   /**< Command opcode */
+    uint8_t  flags;    /**< Fused operation and PRP/SGL selection, always 0 here */
+    uint16_t cid;      /**< Command identifier, returned in the completion */
+    uint32_t nsid;     /**< Namespace ID */
+    uint64_t _reserved;
+    uint64_t mptr;     /**< Metadata pointer */
+    uint64_t prp1;     /**< First PRP entry */
+    uint64_t prp2;     /**< Second PRP entry, or PRP list pointer */
+    uint32_t cdw10;    /**< Command specific */
+    uint32_t cdw11;    /**< Command specific */
+    uint32_t cdw12;    /**< Command specific */
+    uint32_t cdw13;    /**< Command specific */
+    uint32_t cdw14;    /**< Command specific */
+    uint32_t cdw15;    /**< Command specific */
+} nvme_sqe_t;
+
+/**
+ * @brief NVMe completion queue entry
+ */
+typedef struct {
+    uint32_t dw0;      /**< Command specific */
+    uint32_t _reserved;
+    uint16_t sqhd;     /**< Submission queue head */
+    uint16_t sqid;     /**< Submission queue the command came from */
+    uint16_t cid;      /**< Command identifier */
+    uint16_t status;   /**< Phase tag in bit 0, status in bits 1-15 */
+#define NVME_CQE_PHASE      (1U << 0)
+#define NVME_CQE_STATUS(S)  ((S) >> 1)
+} nvme_cqe_t;
+#pragma pack()
+
+/**
+ * @brief A submission/completion queue pair
+ */
+typedef struct {
+    nvme_sqe_t          *sq;    /**< Submission queue */
+    volatile nvme_cqe_t *cq;    /**< Completion queue */
+    uint16_t             size;  /**< Entries in each queue */
+    uint16_t             tail;  /**< Next submission queue entry to fill */
+    uint16_t             head;  /**< Next completion queue entry to check */
+    uint8_t              phase; /**< Phase tag of new completion queue entries */
+    uint8_t              qid;   /**< Queue ID */
+} storage_nvme_queue_t;
+
+/**
+ * @brief Data structure for holding parameters specific to the NVMe driver.
+ */
+typedef struct {
+    uintptr_t mmio;          /**< Controller registers */
+    uint32_t  dstrd;         /**< Doorbell stride, in bytes */
+    uint32_t  nsid;          /**< Namespace in use */
+
+    uint16_t  block_size;    /**< Bytes per logical block */
+    uint32_t  n_blocks;      /**< Number of addressable blocks */
+    uint32_t  max_xfer;      /**< Largest transfer per command, in bytes */
+
+    storage_nvme_queue_t admin; /**< Admin queue pair */
+    storage_nvme_queue_t io;    /**< I/O queue pair */
+
+    uint64_t *prp;           /**< PRP lists, one STORAGE_NVME_PRP_CNT entry run per command slot */
+    uint32_t  busy;          /**< Command slots in flight, one bit per CID */
+
+    storage_stats_t *stats; /**< Statistics of the storage handle */
+} storage_nvme_data_t;
+
+#define STORAGE_NVME_PAGE_SIZE  (4096) /**< Memory page size, as programmed into CC.MPS */
+#define STORAGE_NVME_ADMIN_SIZE (4)    /**< Admin queue entries */
+#define STORAGE_NVME_IO_SIZE    (16)   /**< I/O queue entries, at most one less are kept in flight */
+#define STORAGE_NVME_CHUNK      (0x10000) /**< Bytes per read command */
+#define STORAGE_NVME_PRP_CNT    (32)   /**< PRP list entries per command slot */
+
+/**
+ * @brief Setup storage handle to access the first namespace of an NVMe
+ * controller
+ *
+ * BIOS drive 0x80 + n is assumed to be the n-th NVMe controller.
+ *
+ * @param storage Storage handle to populate
+ * @param index Index of NVMe controller to use
+ * @return int 0 on success, else < 0 if the controller was not found
+ */
+int storage_nvme_init(storage_hand_t *storage, uint8_t index);
+
+
+/*
+ * NVMe registers
+ */
+
+#define NVME_BAR    (0)    /**< PCI BAR holding controller registers */
+#define NVME_PROGIF (0x02) /**< Programming interface of NVMe controllers */
+
+#define NVME_REG(B, O) (*(volatile uint32_t *)((B) + (O)))
+
+#define NVME_REG_CAP   (0x00) /**< Controller capabilities, 64-bit */
+#define NVME_REG_CAPH  (0x04) /**< Controller capabilities, upper 32 bits */
+#define NVME_REG_INTMS (0x0C) /**< Interrupt mask set */
+#define NVME_REG_CC    (0x14) /**< Controller configuration */
+#define NVME_REG_CSTS  (0x1C) /**< Controller status */
+#define NVME_REG_AQA   (0x24) /**< Admin queue attributes */
+#define NVME_REG_ASQ   (0x28) /**< Admin submission queue base, 64-bit */
+#define NVME_REG_ACQ   (0x30) /**< Admin completion queue base, 64-bit */
+#define NVME_REG_DOORBELL (0x1000) /**< First doorbell register */
+
+#define NVME_CAP_MQES(C)  (((C) & 0xFFFF) + 1)   /**< Maximum queue entries */
+#define NVME_CAP_TO(C)    (((C) >> 24) & 0xFF)   /**< Ready timeout, in 500 ms units */
+#define NVME_CAPH_DSTRD(C) ((C) & 0x0F)          /**< Doorbell stride, as 4 << DSTRD bytes */
+
+#define NVME_CC_EN          (1U << 0)              /**< Enable */
+#define NVME_CC_IOSQES(N)   ((N) << 16)            /**< I/O submission queue entry size, 2^N */
+#define NVME_CC_IOCQES(N)   ((N) << 20)            /**< I/O completion queue entry size, 2^N */
+
+#define NVME_CSTS_RDY (1U << 0) /**< Ready */
+#define NVME_CSTS_CFS (1U << 1) /**< Controller fatal status */
+
+#define NVME_ALIGN_PAGE (12) /**< Queue alignment, as a power of two */
+
+#define NVME_ADMIN_CREATE_SQ (0x01) /**< Create I/O submission queue */
+#define NVME_ADMIN_CREATE_CQ (0x05) /**< Create I/O completion queue */
+#define NVME_ADMIN_IDENTIFY  (0x06) /**< Identify */
+#define NVME_CMD_READ        (0x02) /**< Read */
+
+#define NVME_QUEUE_PC (1U << 0) /**< Queue is physically contiguous */
+
+#define NVME_IDENTIFY_NS   (0x00) /**< Identify namespace */
+#define NVME_IDENTIFY_CTRL (0x01) /**< Identify controller */
+
+#define NVME_IDCTRL_MDTS  (77)  /**< Maximum data transfer size, as 2^N pages, 0 if unlimited */
+#define NVME_IDNS_NSZE    (0)   /**< Namespace size in blocks, 64-bit */
+#define NVME_IDNS_FLBAS   (26)  /**< Formatted LBA size, index of LBA format in bits 0-3 */
+#define NVME_IDNS_LBAF    (128) /**< LBA formats, 4 bytes each, LBA data size 2^N in bits 16-23 */
+
+#endif
+
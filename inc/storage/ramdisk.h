@@ -0,0 +1,42 @@
+#ifndef LBOOT_STORAGE_RAMDISK_H
+#define LBOOT_STORAGE_RAMDISK_H
+
+#include "storage/storage.h"
+
+/**
+ * @brief Setup storage handle to access an image held in memory
+ *
+ * Reads are plain copies out of the image, and are byte-granular.
+ *
+ * @param storage Storage handle to populate
+ * @param base Start of the image in memory
+ * @param size Size of the image in bytes
+ * @return int 0 on success, else < 0
+ */
+int storage_ramdisk_init(storage_hand_t *storage, void *base, size_t size);
+
+/**
+ * @brief Read a whole image file into memory at CONFIG_STORAGE_RAMDISK_ADDR,
+ * and setup storage handle to access it
+ *
+ * @param storage Storage handle to populate
+ * @param path Path or URI to image file
+ * @return int 0 on success, else < 0
+ */
+int storage_ramdisk_load(storage_hand_t *storage, const char *path);
+
+/**
+ * @brief Check whether a memory range overlaps the image loaded by
+ * storage_ramdisk_load()
+ *
+ * The kernel and modules are read out of the image, so must not be loaded on
+ * top of it.
+ *
+ * @param begin First address of the range
+ * @param end Last address + 1 of the range
+ * @return int Non-zero if the range overlaps the image
+ */
+int storage_ramdisk_overlaps(uintptr_t begin, uintptr_t end);
+
+#endif
+
@@ -0,0 +1,71 @@
+#ifndef LBOOT_STORAGE_REMOTE_H
+#define LBOOT_STORAGE_REMOTE_H
+
+#include "io/input.h"
+#include "io/output.h"
+#include "storage/storage.h"
+
+/*
+ * Remote block protocol, served by tools/block_server. All fields are
+ * little-endian. Every request is answered by a response header, followed by
+ * `size` bytes of payload and a CRC-16-CCITT covering the header and payload.
+ * Requests that fail their CRC are dropped by the server, and retried by the
+ * client after a timeout.
+ */
+
+#pragma pack(1)
+/**
+ * @brief Remote block request, sent to the server
+ */
+typedef struct {
+    uint8_t  magic;  /**< REMOTE_MAGIC_REQ */
+    uint8_t  cmd;    /**< Command, see `REMOTE_CMD_*` */
+#define REMOTE_CMD_INFO (0x01) /**< Get image size, returned as a 32-bit payload */
+#define REMOTE_CMD_READ (0x02) /**< Read size bytes starting at offset */
+    uint16_t seq;    /**< Sequence number, echoed in the response */
+    uint32_t offset; /**< Offset into image, REMOTE_CMD_READ only */
+    uint32_t size;   /**< Number of bytes, REMOTE_CMD_READ only */
+    uint16_t crc;    /**< CRC-16-CCITT of the preceding fields */
+} remote_req_t;
+
+/**
+ * @brief Remote block response header, received from the server
+ */
+typedef struct {
+    uint8_t  magic;  /**< REMOTE_MAGIC_RESP */
+    uint8_t  status; /**< 0 on success, else the request could not be served */
+    uint16_t seq;    /**< Sequence number of the request */
+    uint32_t size;   /**< Number of payload bytes following */
+} remote_resp_t;
+#pragma pack()
+
+#define REMOTE_MAGIC_REQ  (0xB1) /**< First byte of every request */
+#define REMOTE_MAGIC_RESP (0xB2) /**< First byte of every response */
+
+#define REMOTE_MAX_XFER (0x1000) /**< Largest read per request, bounding the cost of a retry */
+#define REMOTE_RETRIES  (5)      /**< Attempts per request before giving up */
+#define REMOTE_TIMEOUT  (2000)   /**< Timeout for each part of a response, in ms */
+
+/**
+ * @brief Data structure for holding parameters specific to the remote block
+ * driver.
+ */
+typedef struct {
+    input_hand_t     in;    /**< Serial port input */
+    output_hand_t    out;   /**< Serial port output */
+    uint16_t         seq;   /**< Sequence number of the next request */
+
+    storage_stats_t *stats; /**< Statistics of the owning storage handle */
+} storage_remote_data_t;
+
+/**
+ * @brief Setup storage handle to access an image served over a serial port
+ *
+ * @param storage Storage handle to populate
+ * @param port Serial port name, `COM1` to `COM4`
+ * @return int 0 on success, else < 0 if the server did not respond
+ */
+int storage_remote_init(storage_hand_t *storage, const char *port);
+
+#endif
+
@@ -0,0 +1,62 @@
+#ifndef LBOOT_STORAGE_SCHED_H
+#define LBOOT_STORAGE_SCHED_H
+
+#include <stdint.h>
+
+#include "storage/storage.h"
+
+/**
+ * @brief I/O scheduler, collecting a batch of read requests and dispatching
+ * them as few, ordered device reads
+ */
+struct storage_sched_struct {
+    storage_hand_t *storage; /**< Storage device requests are dispatched to */
+    uint16_t        align;   /**< Device block size, requests sharing a block are merged */
+    off_t           head;    /**< End of the last device read, approximating head position */
+
+    storage_req_t  *pending; /**< Requests collected for the next batch, sorted by offset */
+    storage_req_t  *tail;    /**< Last request in pending */
+    unsigned        count;   /**< Number of requests in pending */
+
+    /** @brief Scheduler statistics */
+    struct {
+        uint32_t requests; /**< Number of requests dispatched */
+        uint32_t reads;    /**< Number of device reads issued for them */
+    } stats;
+};
+
+#define STORAGE_SCHED_MERGE_MAX (0x4000) /**< Largest merged read that is staged through a temporary buffer */
+
+/**
+ * @brief Initialize I/O scheduler
+ *
+ * @param sched Scheduler to initialize
+ * @param storage Storage device to dispatch to
+ * @param align Block size of the device, in bytes
+ */
+void storage_sched_init(storage_sched_t *sched, storage_hand_t *storage, uint16_t align);
+
+/**
+ * @brief Add a request to the current batch, without dispatching it
+ *
+ * @param sched Scheduler
+ * @param req Request, with buff, offset, size and optionally done populated.
+ * Neither offset nor size need be aligned.
+ */
+void storage_sched_add(storage_sched_t *sched, storage_req_t *req);
+
+/**
+ * @brief Dispatch the current batch and wait for it to complete
+ *
+ * Adjacent and overlapping requests are merged into single device reads,
+ * which are issued in elevator order starting from the end of the previous
+ * batch. Merged reads go straight into the requesters' buffers when these
+ * are contiguous, else they are staged and scattered back.
+ *
+ * @param sched Scheduler
+ * @return int 0 if every request succeeded, else < 0
+ */
+int storage_sched_run(storage_sched_t *sched);
+
+#endif
+
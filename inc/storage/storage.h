@@ -3,26 +3,224 @@
 
 #include <stdint.h>
 
-typedef struct storage_hand_struct storage_hand_t;
+typedef struct storage_hand_struct  storage_hand_t;
+typedef struct storage_req_struct   storage_req_t;
+typedef struct storage_sched_struct storage_sched_t;
+
+/**
+ * @brief Segment of a scatter-gather read
+ */
+typedef struct {
+    void   *buff;   /**< Buffer to read bytes into */
+    off_t   offset; /**< Offset into storage device to start reading */
+    size_t  size;   /**< Number of bytes to read */
+} storage_seg_t;
+
+/**
+ * @brief Storage device I/O statistics
+ *
+ * @note Every field is a uint32_t counter, see storage_phase()
+ */
+typedef struct {
+    uint32_t requested;  /**< Bytes requested through storage_read() and storage_readv() */
+    uint32_t read;       /**< Bytes transferred by the device, including retries and block padding */
+    uint32_t xfers;      /**< Number of device transactions */
+    uint32_t bios_calls; /**< Number of BIOS calls made */
+    uint32_t retries;    /**< Number of transactions retried */
+    uint32_t resets;     /**< Number of device resets issued after an error */
+    uint32_t failures;   /**< Number of transactions that could not be completed */
+    uint32_t ticks;      /**< Time spent in storage_read() and storage_readv(), in timer ticks */
+    uint32_t cache_hits;   /**< Block cache lookups served from memory, see storage_cache_get() */
+    uint32_t cache_misses; /**< Block cache lookups requiring a read */
+    uint32_t track_hits;   /**< BIOS track cache lookups served from memory */
+    uint32_t track_misses; /**< BIOS track cache lookups requiring a read */
+} storage_stats_t;
+
+/**
+ * @brief Boot phases I/O statistics are broken down into
+ */
+typedef enum {
+    STORAGE_PHASE_INIT = 0, /**< Storage and filesystem initialization */
+    STORAGE_PHASE_CONFIG,   /**< Loading the configuration file */
+    STORAGE_PHASE_KERNEL,   /**< Loading the kernel */
+    STORAGE_PHASE_MODULES,  /**< Loading modules */
+    STORAGE_PHASE_CNT
+} storage_phase_e;
+
+/**
+ * @brief Asynchronous read request
+ */
+struct storage_req_struct {
+    void   *buff;   /**< Buffer to read bytes into */
+    off_t   offset; /**< Offset into storage device to start reading */
+    size_t  size;   /**< Number of bytes to read */
+
+    volatile ssize_t status; /**< STORAGE_REQ_PENDING while in flight, then number of bytes read, or < 0 on error */
+#define STORAGE_REQ_PENDING (INT_MIN)
+
+    /**
+     * @brief Called once the request has completed, may be NULL
+     *
+     * @param req Completed request
+     */
+    void (*done)(storage_req_t *req);
+    void  *priv;    /**< Pointer for use by the submitter */
+
+    storage_req_t *next; /**< Driver queue link - internal use only */
+};
 
 /**
  * @brief Storage device handle
  */
 struct storage_hand_struct {
-    size_t size; /**< Size of storage device, in bytes */
+    size_t   size;       /**< Size of storage device, in bytes */
+    uint16_t block_size; /**< Size of a device block, reads must be aligned to this */
+    uint8_t  buff_align; /**< Alignment required of buffers passed to read and submit, at most 4, 0 if none */
+
+    void    *data;       /**< Pointer to data needed by storage driver */
 
-    void  *data; /**< Pointer to data needed by storage driver */
+    storage_sched_t *sched; /**< Scheduler used by storage_readv(), created on first use */
+    void            *sbuff; /**< Block buffer used by storage_read() for unaligned reads, allocated on first use */
+
+    storage_stats_t stats;                          /**< Statistics since the device was initialized */
+    storage_stats_t phase_stats[STORAGE_PHASE_CNT]; /**< Statistics per boot phase, see storage_phase() */
+    storage_stats_t phase_mark;                     /**< stats at the start of the current phase - internal use only */
+    uint8_t         phase;                          /**< Current boot phase */
 
     /**
      * @brief Read bytes from storage device
      *
+     * @note offset and size must be multiples of block_size, and buff must
+     * be aligned to buff_align, see storage_read() for reading arbitrary ranges
+     *
      * @param buff Buffer to read bytes into
      * @param offset Offset into storage device to start reading
      * @param size Number of bytes to read
      * @return ssize_t Number of bytes successfully read, or < 0 on error
      */
     ssize_t (*read)(storage_hand_t *storage, void *buff, off_t offset, size_t size);
+
+    /**
+     * @brief Queue a read request, returning without waiting for it to
+     * complete. NULL if the driver only supports synchronous reads.
+     *
+     * @param req Request to queue, must remain valid until complete
+     * @return int 0 on success, else < 0
+     */
+    int (*submit)(storage_hand_t *storage, storage_req_t *req);
+
+    /**
+     * @brief Make progress on queued requests without blocking, completing
+     * any that have finished. NULL if submit is NULL.
+     */
+    void (*poll)(storage_hand_t *storage);
+
+    /**
+     * @brief Read a list of segments, in as few device transactions as
+     * possible. NULL to use the generic implementation in storage_readv().
+     *
+     * @param segs Segments to read
+     * @param n_segs Number of segments
+     * @return ssize_t Total number of bytes read, or < 0 on error
+     */
+    ssize_t (*readv)(storage_hand_t *storage, const storage_seg_t *segs, unsigned n_segs);
 };
 
+#define STORAGE_STAGE_MAX (0x4000) /**< Largest read staged through a temporary buffer when the caller's buffer is misaligned */
+
+/**
+ * @brief Read an arbitrary range of bytes from a storage device
+ *
+ * The block-aligned middle of the range is read straight into buff, only a
+ * partial block at either end is staged through the handle's block buffer.
+ * If buff does not meet the driver's buffer alignment, the middle is staged
+ * as well, in chunks of up to STORAGE_STAGE_MAX bytes.
+ *
+ * @param storage Storage device
+ * @param buff Buffer to read bytes into
+ * @param offset Offset into storage device to start reading
+ * @param size Number of bytes to read
+ * @return ssize_t Number of bytes read, or < 0 on error
+ */
+ssize_t storage_read(storage_hand_t *storage, void *buff, off_t offset, size_t size);
+
+/**
+ * @brief Queue a read request
+ *
+ * If the driver does not support asynchronous requests, or the request or its
+ * buffer is not suitably aligned, the read is carried out immediately using
+ * storage_read() and the request is complete on return.
+ *
+ * @param storage Storage device
+ * @param req Request, with buff, offset, size and optionally done populated
+ * @return int 0 if the request was queued or completed, < 0 if it could not
+ * be queued
+ */
+int storage_submit(storage_hand_t *storage, storage_req_t *req);
+
+/**
+ * @brief Make progress on queued requests without blocking
+ *
+ * @param storage Storage device
+ */
+void storage_poll(storage_hand_t *storage);
+
+/**
+ * @brief Wait for a request to complete
+ *
+ * @param storage Storage device the request was submitted to
+ * @param req Request to wait on
+ * @return ssize_t Number of bytes read, or < 0 on error
+ */
+ssize_t storage_wait(storage_hand_t *storage, storage_req_t *req);
+
+/**
+ * @brief Synchronous read implemented by submitting a request and waiting on
+ * it, for drivers that are natively asynchronous
+ *
+ * @see storage_hand_t::read
+ */
+ssize_t storage_read_wait(storage_hand_t *storage, void *buff, off_t offset, size_t size);
+
+/**
+ * @brief Read a list of segments
+ *
+ * Unless the driver provides its own readv, multiple segments are passed
+ * through the device's I/O scheduler, which merges adjacent segments and
+ * orders the resulting reads. A single segment is read as by storage_read().
+ * Segments need not be aligned to the block size.
+ *
+ * @param storage Storage device
+ * @param segs Segments to read
+ * @param n_segs Number of segments
+ * @return ssize_t Total number of bytes read, or < 0 on error
+ */
+ssize_t storage_readv(storage_hand_t *storage, const storage_seg_t *segs, unsigned n_segs);
+
+/**
+ * @brief Start a new boot phase, attributing I/O statistics gathered since
+ * the last call to the previous phase
+ *
+ * @param storage Storage device
+ * @param phase Phase being entered
+ */
+void storage_phase(storage_hand_t *storage, storage_phase_e phase);
+
+/**
+ * @brief Print a summary of I/O statistics, broken down by boot phase
+ *
+ * @param storage Storage device
+ * @param name Name to identify the device by
+ */
+void storage_report(storage_hand_t *storage, const char *name);
+
+/**
+ * @brief Mark a request complete, for use by drivers
+ *
+ * @param req Request to complete
+ * @param status Number of bytes read, or < 0 on error
+ */
+void storage_req_complete(storage_req_t *req, ssize_t status);
+
 #endif
 
@@ -0,0 +1,142 @@
+#ifndef LBOOT_STORAGE_VIRTIO_H
+#define LBOOT_STORAGE_VIRTIO_H
+
+#include "storage/storage.h"
+
+#pragma pack(1)
+/**
+ * @brief Virtqueue descriptor
+ */
+typedef struct {
+    uint64_t addr;  /**< Physical address of buffer */
+    uint32_t len;   /**< Length of buffer */
+    uint16_t flags; /**< Flags, see `VIRTQ_DESC_F_*` */
+#define VIRTQ_DESC_F_NEXT  (1U << 0) /**< Buffer continues in the `next` descriptor */
+#define VIRTQ_DESC_F_WRITE (1U << 1) /**< Buffer is written by the device */
+    uint16_t next;  /**< Next descriptor in the chain, if VIRTQ_DESC_F_NEXT is set */
+} virtq_desc_t;
+
+/**
+ * @brief Virtqueue available ring, written by the driver
+ */
+typedef struct {
+    uint16_t flags; /**< Flags, see `VIRTQ_AVAIL_F_*` */
+#define VIRTQ_AVAIL_F_NO_INTERRUPT (1U << 0) /**< Device need not interrupt on completion */
+    uint16_t idx;   /**< Where the next entry will be placed, free-running */
+    uint16_t ring[]; /**< Heads of descriptor chains */
+} virtq_avail_t;
+
+/**
+ * @brief Virtqueue used ring element
+ */
+typedef struct {
+    uint32_t id;  /**< Head of the completed descriptor chain */
+    uint32_t len; /**< Bytes written by the device */
+} virtq_used_elem_t;
+
+/**
+ * @brief Virtqueue used ring, written by the device
+ */
+typedef struct {
+    uint16_t flags;
+    uint16_t idx;   /**< Where the device will place the next entry, free-running */
+    virtq_used_elem_t ring[];
+} virtq_used_t;
+
+/**
+ * @brief virtio-blk request header
+ */
+typedef struct {
+    uint32_t type;     /**< Request type, see `VIRTIO_BLK_T_*` */
+    uint32_t reserved;
+    uint64_t sector;   /**< First 512-byte sector of the request */
+} virtio_blk_req_t;
+#pragma pack()
+
+#define VIRTIO_BLK_T_IN  (0) /**< Read */
+
+#define VIRTIO_BLK_S_OK  (0) /**< Request completed successfully */
+
+/**
+ * @brief Per-request state for one of the requests in flight
+ */
+typedef struct {
+    virtio_blk_req_t  hdr;    /**< Request header, read by the device */
+    volatile uint8_t  status; /**< Request status, written by the device */
+    uint8_t           busy;   /**< Request has been submitted and not yet completed */
+} storage_virtio_req_t;
+
+/**
+ * @brief Data structure for holding parameters specific to the virtio-blk
+ * driver.
+ */
+typedef struct {
+    uint16_t  iobase;       /**< Legacy I/O register base */
+    uint16_t  q_size;       /**< Number of descriptors in the virtqueue */
+    uint16_t  last_used;    /**< Used ring index up to which completions have been processed */
+    uint8_t   n_segs;       /**< Data descriptors per request */
+    uint32_t  seg_size;     /**< Largest data descriptor, in bytes */
+
+    uint32_t  n_sectors;    /**< Number of addressable sectors */
+
+    virtq_desc_t          *desc;  /**< Descriptor table */
+    virtq_avail_t         *avail; /**< Available ring */
+    volatile virtq_used_t *used;  /**< Used ring */
+
+    storage_virtio_req_t  *reqs;  /**< In flight request state, STORAGE_VIRTIO_INFLIGHT entries */
+
+    storage_stats_t *stats; /**< Statistics of the storage handle */
+} storage_virtio_data_t;
+
+#define STORAGE_VIRTIO_SECTOR_SIZE (512)   /**< virtio-blk always addresses 512-byte sectors */
+#define STORAGE_VIRTIO_CHUNK       (128)   /**< Sectors per request */
+#define STORAGE_VIRTIO_INFLIGHT    (8)     /**< Requests kept in flight at once */
+#define STORAGE_VIRTIO_MAX_SEGS    (4)     /**< Most data descriptors per request */
+
+/**
+ * @brief Setup storage handle to access a virtio-blk device through its
+ * legacy PCI interface
+ *
+ * BIOS drive 0x80 + n is assumed to be the n-th virtio-blk device.
+ *
+ * @param storage Storage handle to populate
+ * @param index Index of virtio-blk device to use
+ * @return int 0 on success, else < 0 if the device was not found
+ */
+int storage_virtio_init(storage_hand_t *storage, uint8_t index);
+
+
+/*
+ * Legacy virtio PCI registers
+ */
+
+#define VIRTIO_PCI_VENDOR     (0x1AF4) /**< virtio PCI vendor ID */
+#define VIRTIO_PCI_DEVICE_BLK (0x1001) /**< Transitional virtio-blk device ID */
+#define VIRTIO_BAR            (0)      /**< PCI BAR holding legacy I/O registers */
+
+#define VIRTIO_REG_DEVICE_FEATURES(P) ((P) + 0x00) /**< Device features, 32-bit */
+#define VIRTIO_REG_GUEST_FEATURES(P)  ((P) + 0x04) /**< Accepted features, 32-bit */
+#define VIRTIO_REG_QUEUE_PFN(P)       ((P) + 0x08) /**< Queue page frame number, 32-bit */
+#define VIRTIO_REG_QUEUE_SIZE(P)      ((P) + 0x0C) /**< Queue size, 16-bit */
+#define VIRTIO_REG_QUEUE_SELECT(P)    ((P) + 0x0E) /**< Queue select, 16-bit */
+#define VIRTIO_REG_QUEUE_NOTIFY(P)    ((P) + 0x10) /**< Queue notify, 16-bit */
+#define VIRTIO_REG_STATUS(P)          ((P) + 0x12) /**< Device status, 8-bit */
+#define VIRTIO_REG_ISR(P)             ((P) + 0x13) /**< ISR status, 8-bit */
+#define VIRTIO_REG_CONFIG(P)          ((P) + 0x14) /**< Device specific configuration */
+
+#define VIRTIO_STATUS_ACKNOWLEDGE (1U << 0) /**< Guest has noticed the device */
+#define VIRTIO_STATUS_DRIVER      (1U << 1) /**< Guest has a driver for the device */
+#define VIRTIO_STATUS_DRIVER_OK   (1U << 2) /**< Driver is ready */
+#define VIRTIO_STATUS_FAILED      (1U << 7) /**< Driver has given up on the device */
+
+#define VIRTIO_QUEUE_ALIGN (12) /**< Legacy virtqueue alignment, as a power of two */
+
+#define VIRTIO_BLK_F_SIZE_MAX (1U << 1) /**< `size_max` limits the size of a data descriptor */
+#define VIRTIO_BLK_F_SEG_MAX  (1U << 2) /**< `seg_max` limits data descriptors per request */
+
+#define VIRTIO_BLK_CFG_CAPACITY(P) (VIRTIO_REG_CONFIG(P) + 0)  /**< Capacity in sectors, 64-bit */
+#define VIRTIO_BLK_CFG_SIZE_MAX(P) (VIRTIO_REG_CONFIG(P) + 8)  /**< Largest data descriptor, 32-bit */
+#define VIRTIO_BLK_CFG_SEG_MAX(P)  (VIRTIO_REG_CONFIG(P) + 12) /**< Most data descriptors per request, 32-bit */
+
+#endif
+
@@ -1,5 +1,8 @@
 .code32
 
+/* Placed below 64 KiB, as this runs in real mode with DS set to 0 */
+.section .realmode, "awx"
+
 .extern bios_idt
 
 /* int bios_call(bios_call_t *) */
@@ -81,12 +84,15 @@ bios_call_asm:
     movb %al,   (_int_id)
 
     /* Load parameters */
+    pushw 32(%di)       /* DS is loaded last, as it affects access to the parameters */
+    movw  34(%di), %es
     movl  4(%di), %eax
     movl  8(%di), %ebx
     movl 12(%di), %ecx
     movl 16(%di), %edx
     movl 20(%di), %esi
     movl 24(%di), %edi
+    popw  %ds
     /* @note Not loading EFLAGS, not sure any interrupts use any of those bits as input */
 
     /* @note INT only accepts immediates, so we need to modify the code */
@@ -95,7 +101,12 @@ _int_id:
     .byte 0x00 /* imm8 */
 
     /* Save results */
-    pushw %bp
+    pushfl              /* EFLAGS must be saved before it is modified below */
+    /* Restore data segments, as they may have been changed for the call.
+     * @note BP is clobbered here, but is restored by popal on return. */
+    xorw  %bp, %bp
+    movw  %bp, %ds
+    movw  %bp, %es
     movw  (_bios_call_ptr), %bp
     movl  %eax,  4(%bp)
     movl  %ebx,  8(%bp)
@@ -104,12 +115,9 @@ _int_id:
     movl  %esi, 20(%bp)
     movl  %edi, 24(%bp)
     /* Save EFLAGS */
-    pushfl
     popl   %eax
     movl   %eax, 28(%bp)
 
-    popw %bp
-
 
     /*
      * Enter protected mode
@@ -46,6 +46,12 @@ static void _config_print(const config_data_t *cfg) {
     printf("  config_version: %hhu\n", cfg->config_version);
     printf("     kernel_path: %s\n",   cfg->kernel_path);
     printf("  kernel_cmdline: %s\n",   cfg->kernel_cmdline);
+#ifdef CONFIG_STORAGE_RAMDISK
+    printf("    ramdisk_path: %s\n",   cfg->ramdisk_path);
+#endif
+#ifdef CONFIG_STORAGE_REMOTE
+    printf("     remote_port: %s\n",   cfg->remote_port);
+#endif
     printf("         modules: %u\n",   cfg->module_count);
 
     for(unsigned i = 0; i < cfg->module_count; i++) {
@@ -107,6 +113,16 @@ static int _config_parse(config_data_t *cfg, char *cfgdata) {
             } else if(!strcmp(line, "CMDLINE")) {
                 cfg->kernel_cmdline = alloc(val_len+1, 0);
                 strcpy(cfg->kernel_cmdline, val);
+#ifdef CONFIG_STORAGE_RAMDISK
+            } else if(!strcmp(line, "RAMDISK")) {
+                cfg->ramdisk_path = alloc(val_len+1, 0);
+                strcpy(cfg->ramdisk_path, val);
+#endif
+#ifdef CONFIG_STORAGE_REMOTE
+            } else if(!strcmp(line, "REMOTE")) {
+                cfg->remote_port = alloc(val_len+1, 0);
+                strcpy(cfg->remote_port, val);
+#endif
             } else if(!strcmp(line, "MODULE")) {
                 if(cfg->module_count == MAX_MODULES) {
                     printf("_config_parse: Maximum module count (%u) exceeded!\n", MAX_MODULES);
@@ -5,6 +5,7 @@
 #include "exec/multiboot.h"
 #include "io/output.h"
 #include "mm/alloc.h"
+#include "storage/ramdisk.h"
 
 #include "exec/fmt/elf.h"
 #include "exec/fmt/flat.h"
@@ -66,7 +67,7 @@ int exec_open(exec_hand_t *exec, file_hand_t *file) {
 /* @todo Move this elsewhere, as it could be useful. */
 #define ALIGN(P, A) (((P) % (A)) ? (P) : ((P) + ((A) - ((P) % (A)))))
 
-static int _exec_load_modules(exec_hand_t *exec, config_data_t *cfg) {
+int exec_load_modules(exec_hand_t *exec, config_data_t *cfg) {
     uintptr_t addr = exec->data_end;
 
     file_hand_t modfile;
@@ -78,12 +79,19 @@ static int _exec_load_modules(exec_hand_t *exec, config_data_t *cfg) {
 
         /* @todo Do not only search this filesystem, create generic accessor. */
         if(file_open(&modfile, cfg->modules[i].module_path)) {
-            printf("_exec_load_modules: Could not find file\n");
+            printf("exec_load_modules: Could not find file\n");
             return -1;
         }
 
+#ifdef CONFIG_STORAGE_RAMDISK
+        if(storage_ramdisk_overlaps(addr, addr + modfile.size)) {
+            printf("exec_load_modules: Module would overwrite the RAM disk image\n");
+            return -1;
+        }
+#endif
+
         if(modfile.read(&modfile, (void *)addr, modfile.size, 0) != (ssize_t)modfile.size) {
-            printf("_exec_load_modules: Could not read from file\n");
+            printf("exec_load_modules: Could not read from file\n");
             return -1;
         }
 
@@ -131,18 +139,15 @@ static void _exec_enter(uintptr_t entrypoint) {
 }
 
 
-int exec_exec(exec_hand_t *exec, config_data_t *cfg) {
+int exec_load(exec_hand_t *exec) {
     if(exec->prepare(exec)) {
         return -1;
     }
-    if(exec->load(exec)) {
-        return -1;
-    }
 
-    if(_exec_load_modules(exec, cfg)) {
-        return -1;
-    }
+    return exec->load(exec);
+}
 
+int exec_exec(exec_hand_t *exec, config_data_t *cfg) {
     int mboot = _exec_detect_multiboot(exec);
     if(mboot == 1) {
         printf("Kernel uses multiboot 1 - this is unsupported.\n");
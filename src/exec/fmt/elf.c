@@ -3,6 +3,8 @@
 #include "exec/fmt/elf.h"
 #include "io/output.h"
 #include "mm/alloc.h"
+#include "storage/file.h"
+#include "storage/ramdisk.h"
 
 typedef struct exec_elf_data_struct {
     elf_header_t *ehdr; /**< Buffer containing ELF file header */
@@ -118,6 +120,10 @@ elf_prep_fail_1:
 static int _elf_load_phdr(exec_hand_t *exec) {
     exec_elf_data_t *edata = exec->data;
 
+    storage_seg_t *segs   = alloc(edata->ehdr->e32.phnum * sizeof(storage_seg_t), 0);
+    unsigned       n_segs = 0;
+    size_t         total  = 0;
+
     for(unsigned i = 0; i < edata->ehdr->e32.phnum; i++) {
         elf32_phdr_t *phdr = &edata->phdr[i];
         if(phdr->type == ELF_PHDR_TYPE_LOAD) {
@@ -135,17 +141,40 @@ static int _elf_load_phdr(exec_hand_t *exec) {
 #if (DEBUG_EXEC_ELF)
                 printf("  Loading  %6u bytes from file into %p.\n", phdr->filesz, phdr->paddr);
 #endif
-                if(exec->file->read(exec->file, (void *)phdr->paddr, phdr->filesz, phdr->offset) != (ssize_t)phdr->filesz) {
-                    printf("_elf_load_phdr: Failure reading %u bytes of data into %p from %p\n", phdr->filesz, phdr->paddr, phdr->offset);
-                    return -1;
-                }
+                segs[n_segs].buff   = (void *)phdr->paddr;
+                segs[n_segs].offset = phdr->offset;
+                segs[n_segs].size   = phdr->filesz;
+                total += phdr->filesz;
+                n_segs++;
             }
-            if(phdr->filesz < phdr->memsz) {
+        }
+    }
+
+#ifdef CONFIG_STORAGE_RAMDISK
+    if(storage_ramdisk_overlaps(exec->data_begin, exec->data_end)) {
+        printf("_elf_load_phdr: Kernel would overwrite the RAM disk image\n");
+        free(segs);
+        return -1;
+    }
+#endif
+
+    /* All segments are read at once, so the storage layer can merge and order
+     * the underlying reads */
+    if(file_readv(exec->file, segs, n_segs) != (ssize_t)total) {
+        printf("_elf_load_phdr: Failure reading %u bytes of segment data\n", total);
+        free(segs);
+        return -1;
+    }
+    free(segs);
+
+    for(unsigned i = 0; i < edata->ehdr->e32.phnum; i++) {
+        elf32_phdr_t *phdr = &edata->phdr[i];
+        if((phdr->type == ELF_PHDR_TYPE_LOAD) &&
+           (phdr->filesz < phdr->memsz)) {
 #if (DEBUG_EXEC_ELF)
-                printf("  Clearing %6u bytes at             %p.\n", phdr->memsz - phdr->filesz, phdr->paddr + phdr->filesz);
+            printf("  Clearing %6u bytes at             %p.\n", phdr->memsz - phdr->filesz, phdr->paddr + phdr->filesz);
 #endif
-                memset((void *)(phdr->paddr + phdr->filesz), 0, phdr->memsz - phdr->filesz);
-            }
+            memset((void *)(phdr->paddr + phdr->filesz), 0, phdr->memsz - phdr->filesz);
         }
     }
 
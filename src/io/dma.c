@@ -0,0 +1,37 @@
+#include "io/dma.h"
+#include "io/ioport.h"
+
+/** @brief Page register for each 8-bit channel */
+static const uint8_t _dma_page_regs[4] = { 0x87, 0x83, 0x81, 0x82 };
+
+int dma_setup(uint8_t channel, void *buff, uint32_t size, uint8_t mode) {
+    uint32_t start = (uint32_t)buff;
+    uint32_t end   = start + size - 1;
+
+    if((channel >= 4) ||
+       (size == 0) || (size > DMA_BOUNDARY) ||
+       (end >= DMA_LIMIT) ||
+       ((start / DMA_BOUNDARY) != (end / DMA_BOUNDARY))) {
+        return -1;
+    }
+
+    outb(DMA_REG_MASK, DMA_MASK_SET | channel);
+
+    /* Address and count are written low byte first, after resetting the
+     * flip-flop. The count register holds one less than the transfer size. */
+    outb(DMA_REG_FLIPFLOP, 0xFF);
+    outb(DMA_REG_ADDR(channel), (uint8_t)start);
+    outb(DMA_REG_ADDR(channel), (uint8_t)(start >> 8));
+    outb(_dma_page_regs[channel], (uint8_t)(start >> 16));
+
+    outb(DMA_REG_FLIPFLOP, 0xFF);
+    outb(DMA_REG_COUNT(channel), (uint8_t)(size - 1));
+    outb(DMA_REG_COUNT(channel), (uint8_t)((size - 1) >> 8));
+
+    outb(DMA_REG_MODE, mode | channel);
+
+    outb(DMA_REG_MASK, channel);
+
+    return 0;
+}
+
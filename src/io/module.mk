@@ -1,4 +1,5 @@
 
+obj-y += $(MDIR)dma.o
 obj-y += $(MDIR)output.o
 obj-y += $(MDIR)vga.o
 # TODO: Support fully disabling serial support
@@ -14,6 +14,8 @@ dirs-y := bios    \
           storage \
           time
 
+dirs-$(CONFIG_PCI) += pci
+
 include $(patsubst %,$(MDIR)%/module.mk,$(dirs-y))
 
 cflags-$(CONFIG_VERBOSE_PANIC)      += -DCONFIG_VERBOSE_PANIC
@@ -24,6 +26,12 @@ cflags-$(CONFIG_WORKINGSTATUS)      += -DCONFIG_WORKINGSTATUS
 # Debug config
 cflags-y += -DDEBUG_CONFIG=$(CONFIG_DEBUG_CONFIG) \
             -DDEBUG_STORAGE_BIOS=$(CONFIG_DEBUG_STORAGE_BIOS) \
+            -DDEBUG_STORAGE_FDC=$(CONFIG_DEBUG_STORAGE_FDC) \
+            -DDEBUG_STORAGE_ATA=$(CONFIG_DEBUG_STORAGE_ATA) \
+            -DDEBUG_STORAGE_AHCI=$(CONFIG_DEBUG_STORAGE_AHCI) \
+            -DDEBUG_STORAGE_VIRTIO=$(CONFIG_DEBUG_STORAGE_VIRTIO) \
+            -DDEBUG_STORAGE_NVME=$(CONFIG_DEBUG_STORAGE_NVME) \
+            -DDEBUG_STORAGE_REMOTE=$(CONFIG_DEBUG_STORAGE_REMOTE) \
             -DDEBUG_FS_FAT=$(CONFIG_DEBUG_FS_FAT) \
             -DDEBUG_EXEC=$(CONFIG_DEBUG_EXEC) \
             -DDEBUG_EXEC_ELF=$(CONFIG_DEBUG_EXEC_ELF) \
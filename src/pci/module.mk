@@ -0,0 +1,3 @@
+
+obj-y += $(MDIR)pci.o
+
@@ -0,0 +1,92 @@
+#include "io/ioport.h"
+#include "pci/pci.h"
+
+uint32_t pci_read32(pci_addr_t addr, uint8_t reg) {
+    outl(PCI_CONFIG_ADDRESS, PCI_CONFIG_ENABLE | addr | (reg & 0xFC));
+    return inl(PCI_CONFIG_DATA);
+}
+
+uint16_t pci_read16(pci_addr_t addr, uint8_t reg) {
+    return (uint16_t)(pci_read32(addr, reg) >> ((reg & 0x02) * 8));
+}
+
+uint8_t pci_read8(pci_addr_t addr, uint8_t reg) {
+    return (uint8_t)(pci_read32(addr, reg) >> ((reg & 0x03) * 8));
+}
+
+void pci_write32(pci_addr_t addr, uint8_t reg, uint32_t val) {
+    outl(PCI_CONFIG_ADDRESS, PCI_CONFIG_ENABLE | addr | (reg & 0xFC));
+    outl(PCI_CONFIG_DATA, val);
+}
+
+void pci_write16(pci_addr_t addr, uint8_t reg, uint16_t val) {
+    outl(PCI_CONFIG_ADDRESS, PCI_CONFIG_ENABLE | addr | (reg & 0xFC));
+    outw(PCI_CONFIG_DATA + (reg & 0x02), val);
+}
+
+/**
+ * @brief Find the nth function for which (reg & mask) == value
+ *
+ * @param reg 32-bit register to compare
+ * @param mask Bits of register to compare
+ * @param value Value to compare against
+ * @param index Number of matching functions to skip
+ * @param addr Where to store location of the function
+ * @return 0 if found, else < 0
+ */
+static int _pci_find(uint8_t reg, uint32_t mask, uint32_t value, unsigned index, pci_addr_t *addr) {
+    for(unsigned bus = 0; bus < 256; bus++) {
+        for(unsigned dev = 0; dev < 32; dev++) {
+            unsigned n_funcs = 1;
+            for(unsigned func = 0; func < n_funcs; func++) {
+                pci_addr_t faddr = PCI_ADDR(bus, dev, func);
+                if(pci_read16(faddr, PCI_REG_VENDOR) == 0xFFFF) {
+                    continue;
+                }
+                if((func == 0) &&
+                   (pci_read8(faddr, PCI_REG_HEADERTYPE) & PCI_HEADERTYPE_MF)) {
+                    n_funcs = 8;
+                }
+
+                if(((pci_read32(faddr, reg) & mask) == value) &&
+                   !(index--)) {
+                    *addr = faddr;
+                    return 0;
+                }
+            }
+        }
+    }
+
+    return -1;
+}
+
+int pci_find_class(uint8_t class, uint8_t subclass, unsigned index, pci_addr_t *addr) {
+    return _pci_find(PCI_REG_CLASS, 0xFFFF0000,
+                     ((uint32_t)class << 24) | ((uint32_t)subclass << 16), index, addr);
+}
+
+int pci_find_device(uint16_t vendor, uint16_t device, unsigned index, pci_addr_t *addr) {
+    return _pci_find(PCI_REG_VENDOR, 0xFFFFFFFF,
+                     ((uint32_t)device << 16) | vendor, index, addr);
+}
+
+uint32_t pci_bar(pci_addr_t addr, uint8_t bar) {
+    uint32_t val = pci_read32(addr, PCI_REG_BAR(bar));
+
+    if(val & PCI_BAR_IO) {
+        return val & 0xFFFC;
+    }
+
+    if(((val & PCI_BAR_TYPE__MSK) == PCI_BAR_TYPE_64) &&
+       ((bar >= 5) || pci_read32(addr, PCI_REG_BAR(bar + 1)))) {
+        /* Not reachable without paging */
+        return 0;
+    }
+
+    return val & 0xFFFFFFF0;
+}
+
+void pci_enable(pci_addr_t addr, uint16_t flags) {
+    pci_write16(addr, PCI_REG_COMMAND, pci_read16(addr, PCI_REG_COMMAND) | flags);
+}
+
@@ -1,6 +1,7 @@
 #include <string.h>
 #include <stddef.h>
 
+#include "bios/bios.h"
 #include "config/config.h"
 #include "mm/alloc.h"
 #include "exec/exec.h"
@@ -8,11 +9,23 @@
 #include "io/output.h"
 #include "io/serial.h"
 #include "io/vga.h"
+#include "storage/ahci.h"
+#include "storage/ata.h"
 #include "storage/bios.h"
+#include "storage/fdc.h"
 #include "storage/fs/fs.h"
 #include "storage/fs/fat.h"
+#include "storage/nvme.h"
+#include "storage/ramdisk.h"
+#include "storage/remote.h"
+#include "storage/virtio.h"
 #include "time/time.h"
 
+#if defined(CONFIG_STORAGE_VIRTIO) || defined(CONFIG_STORAGE_NVME) || \
+    defined(CONFIG_STORAGE_AHCI)   || defined(CONFIG_STORAGE_ATA)
+#define NATIVE_DISKS /**< Native hard disk drivers are available */
+#endif
+
 static void _init_data(void) {
     /* Clear BSS */
     extern int __lboot_bss_begin, __lboot_bss_end;
@@ -25,11 +38,73 @@ static output_hand_t  _serial;
 #endif
 static storage_hand_t _bootdev;
 static fs_hand_t      _bootfs;
+#ifdef CONFIG_STORAGE_REMOTE
+static storage_hand_t _remote;
+static fs_hand_t      _remotefs;
+#endif
+#ifdef CONFIG_STORAGE_RAMDISK
+static storage_hand_t _ramdisk;
+static fs_hand_t      _ramfs;
+#endif
 static exec_hand_t    _exec;
 
 static const char   *_config_file = "LBOOT/LBOOT.CFG";
 static config_data_t _cfg;
 
+/**
+ * @brief Storage devices that may be in use, for I/O statistics
+ */
+static const struct {
+    storage_hand_t *dev;
+    const char     *name;
+} _storage_devs[] = {
+    { &_bootdev, "boot device"  },
+#ifdef CONFIG_STORAGE_REMOTE
+    { &_remote,  "remote image" },
+#endif
+#ifdef CONFIG_STORAGE_RAMDISK
+    { &_ramdisk, "RAM disk"     },
+#endif
+};
+
+#ifdef NATIVE_DISKS
+/**
+ * @brief Set up the boot device using a native driver, keeping it only if it
+ * holds the same disk the BIOS booted from
+ *
+ * BIOS drive numbers say nothing about which controller a disk is attached
+ * to, so 0x80 + n is only a guess at which disk the driver should take. On a
+ * mismatch, the next driver is tried, so the order drivers are tried in does
+ * not decide which disk is used.
+ *
+ * @param init Native driver initialization function
+ * @param bootsect First sector of the boot disk, as read through the BIOS
+ * @return int 0 if the driver now handles the boot disk, else < 0
+ */
+static int _bootdev_native(int (*init)(storage_hand_t *, uint8_t), const void *bootsect) {
+    uint8_t sect[512];
+
+    if(init(&_bootdev, bios_boot_drive - 0x80) ||
+       (storage_read(&_bootdev, sect, 0, sizeof(sect)) != sizeof(sect)) ||
+       memcmp(sect, bootsect, sizeof(sect))) {
+        return -1;
+    }
+
+    return 0;
+}
+#endif
+
+/**
+ * @brief Start a new boot phase on every storage device
+ *
+ * @param phase Phase being entered
+ */
+static void _storage_phase(storage_phase_e phase) {
+    for(unsigned i = 0; i < (sizeof(_storage_devs) / sizeof(_storage_devs[0])); i++) {
+        storage_phase(_storage_devs[i].dev, phase);
+    }
+}
+
 void cstart(void) {
     _init_data();
 
@@ -58,9 +133,42 @@ void cstart(void) {
 
     puts("LBoot -- Built "__DATE__"\n");
 
-    /* @todo Actually use the device ID passed to us from the BIOS, and don't
-     * directly handle this in main. */
-    if(storage_bios_init(&_bootdev, 0x00)) {
+    /* @todo Don't directly handle this in main. */
+    int ret = -1;
+#ifdef NATIVE_DISKS
+    void *bootsect = (bios_boot_drive >= 0x80) ? storage_bios_first_sector(bios_boot_drive) : NULL;
+#endif
+#ifdef CONFIG_STORAGE_FDC
+    if(bios_boot_drive < 0x80) {
+        ret = storage_fdc_init(&_bootdev, bios_boot_drive);
+    }
+#endif
+#ifdef CONFIG_STORAGE_VIRTIO
+    if(ret && bootsect) {
+        ret = _bootdev_native(storage_virtio_init, bootsect);
+    }
+#endif
+#ifdef CONFIG_STORAGE_NVME
+    if(ret && bootsect) {
+        ret = _bootdev_native(storage_nvme_init, bootsect);
+    }
+#endif
+#ifdef CONFIG_STORAGE_AHCI
+    if(ret && bootsect) {
+        ret = _bootdev_native(storage_ahci_init, bootsect);
+    }
+#endif
+#ifdef CONFIG_STORAGE_ATA
+    if(ret && bootsect) {
+        ret = _bootdev_native(storage_ata_init, bootsect);
+    }
+#endif
+#ifdef NATIVE_DISKS
+    if(bootsect) {
+        free(bootsect);
+    }
+#endif
+    if(ret && storage_bios_init(&_bootdev, bios_boot_drive)) {
         panic("Failed initializing storage!\n");
     }
 
@@ -70,15 +178,40 @@ void cstart(void) {
 
     file_set_default_fs(&_bootfs);
 
+    _storage_phase(STORAGE_PHASE_CONFIG);
     print_status("Loading config `%s`", _config_file);
     if(config_load(&_cfg, _config_file)) {
         panic("Failed loading config!\n");
     }
 
+#ifdef CONFIG_STORAGE_REMOTE
+    if(_cfg.remote_port) {
+        print_status("Mounting remote image on %s", _cfg.remote_port);
+        if(storage_remote_init(&_remote, _cfg.remote_port) ||
+           fs_fat_init(&_remotefs, &_remote, 0x00)) {
+            panic("Failed mounting remote image!\n");
+        }
+
+        file_set_default_fs(&_remotefs);
+    }
+#endif
+#ifdef CONFIG_STORAGE_RAMDISK
+    if(_cfg.ramdisk_path) {
+        print_status("Loading RAM disk `%s`", _cfg.ramdisk_path);
+        if(storage_ramdisk_load(&_ramdisk, _cfg.ramdisk_path) ||
+           fs_fat_init(&_ramfs, &_ramdisk, 0x00)) {
+            panic("Failed loading RAM disk!\n");
+        }
+
+        file_set_default_fs(&_ramfs);
+    }
+#endif
+
     if(_cfg.kernel_path == NULL) {
         panic("Kernel not specified in config!\n");
     }
     print_status("Loading kernel `%s`", _cfg.kernel_path);
+    _storage_phase(STORAGE_PHASE_KERNEL);
 
     file_hand_t kernel;
     if(file_open(&kernel, _cfg.kernel_path)) {
@@ -89,8 +222,26 @@ void cstart(void) {
         panic("Failed to open kernel for execution!\n");
     }
 
+    if(exec_load(&_exec)) {
+        panic("Failed to load kernel!\n");
+    }
+
+    _storage_phase(STORAGE_PHASE_MODULES);
+    if(exec_load_modules(&_exec, &_cfg)) {
+        panic("Failed to load modules!\n");
+    }
+
+#ifdef CONFIG_STORAGE_REPORT
+    for(unsigned i = 0; i < (sizeof(_storage_devs) / sizeof(_storage_devs[0])); i++) {
+        /* Devices that were never set up are left zeroed */
+        if(_storage_devs[i].dev->read) {
+            storage_report(_storage_devs[i].dev, _storage_devs[i].name);
+        }
+    }
+#endif
+
     if(exec_exec(&_exec, &_cfg)) {
-        panic("Failed to load and execute kernel!\n");
+        panic("Failed to execute kernel!\n");
     }
 
     puts("OK\n");
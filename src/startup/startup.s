@@ -8,6 +8,9 @@
 .global start
 .type   start, @function
 start:
+    /* Save boot drive passed in by stage 1 */
+    movb %dl, (bios_boot_drive)
+
     /* Print boot message */
     movw $boot_message, %si
     call msg_print
@@ -104,6 +107,15 @@ msg_print:
 boot_message:
     .asciz "\r\nStage2.\r\n"
 
+/* @note Placed in .realmode rather than .bss, as .bss is cleared by cstart,
+ * and this is written from real mode with a 16-bit address */
+.section .realmode.bios_boot_drive, "aw"
+.global bios_boot_drive
+bios_boot_drive:
+    .byte 0x00
+
+.section .entrypoint
+
 gdtr:
     .word ((gdt_end - gdt) - 1)  /* Limit */
     .long gdt                    /* Base */
@@ -0,0 +1,455 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "io/output.h"
+#include "mm/alloc.h"
+#include "pci/pci.h"
+#include "storage/ahci.h"
+#include "time/time.h"
+
+/* @note since we currently allow only a single device open at a time, having
+ * this statically declared should be fine. */
+static storage_ahci_data_t _ahci_data = { 0 };
+
+#define AHCI_TIMEOUT_PORT (500)  /**< Timeout for the port engine to start or stop, in ms */
+#define AHCI_TIMEOUT_CMD  (5000) /**< Timeout for a batch of commands to complete, in ms */
+
+/** Keep the compiler from moving command setup past MMIO accesses */
+#define _ahci_barrier() asm volatile("" ::: "memory")
+
+static ssize_t _read(storage_hand_t *storage, void *buff, off_t offset, size_t size);
+static int     _ahci_port_start(storage_ahci_data_t *adata);
+static int     _ahci_identify(storage_ahci_data_t *adata, uint16_t *ident);
+
+int storage_ahci_init(storage_hand_t *storage, uint8_t index) {
+    memset(storage, 0, sizeof(storage_hand_t));
+    memset(&_ahci_data, 0, sizeof(_ahci_data));
+    _ahci_data.stats = &storage->stats;
+
+    pci_addr_t pci;
+    for(unsigned i = 0; !pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_STORAGE_SATA, i, &pci); i++) {
+        if(pci_read8(pci, PCI_REG_PROGIF) != AHCI_PROGIF) {
+            continue;
+        }
+
+        uintptr_t abar = pci_bar(pci, AHCI_BAR);
+        if(!abar) {
+            continue;
+        }
+        pci_enable(pci, PCI_COMMAND_MEMORY | PCI_COMMAND_MASTER);
+        AHCI_REG(abar, AHCI_REG_GHC) |= AHCI_GHC_AE;
+
+        uint32_t pi = AHCI_REG(abar, AHCI_REG_PI);
+        for(unsigned port = 0; port < AHCI_PORTS_MAX; port++) {
+            if(!(pi & (1UL << port))) {
+                continue;
+            }
+
+            uintptr_t preg = AHCI_PORT(abar, port);
+            if(((AHCI_REG(preg, AHCI_PREG_SSTS) & AHCI_SSTS_DET__MSK) != AHCI_SSTS_DET_PRESENT) ||
+               (AHCI_REG(preg, AHCI_PREG_SIG) != AHCI_SIG_ATA)) {
+                continue;
+            }
+            if(index--) {
+                continue;
+            }
+
+            _ahci_data.abar    = abar;
+            _ahci_data.port    = preg;
+            _ahci_data.n_slots = AHCI_CAP_NCS(AHCI_REG(abar, AHCI_REG_CAP));
+
+            if(_ahci_port_start(&_ahci_data)) {
+                printf("storage_ahci: Port %u did not start\n", port);
+                return -1;
+            }
+
+            uint16_t *ident = alloc(512, 0);
+            if(_ahci_identify(&_ahci_data, ident)) {
+                free(ident);
+                printf("storage_ahci: Port %u did not answer IDENTIFY\n", port);
+                return -1;
+            }
+
+            _ahci_data.n_sectors = ident[AHCI_IDENT_LBA28_SECTORS] |
+                                   ((uint32_t)ident[AHCI_IDENT_LBA28_SECTORS + 1] << 16);
+            if(ident[AHCI_IDENT_CMDSET2] & (1U << 10)) {
+                _ahci_data.flags |= STORAGE_AHCI_FLAG_LBA48;
+                /* Only the first 2^32 sectors are usable regardless */
+                if(ident[AHCI_IDENT_LBA48_SECTORS + 2] || ident[AHCI_IDENT_LBA48_SECTORS + 3]) {
+                    _ahci_data.n_sectors = 0xFFFFFFFF;
+                } else {
+                    _ahci_data.n_sectors = ident[AHCI_IDENT_LBA48_SECTORS] |
+                                           ((uint32_t)ident[AHCI_IDENT_LBA48_SECTORS + 1] << 16);
+                }
+            }
+            if(ident[AHCI_IDENT_SATA_CAPS] & (1U << 8)) {
+                /* The device may accept fewer queued commands than the HBA has slots */
+                uint8_t depth = (ident[AHCI_IDENT_QUEUE_DEPTH] & 0x1F) + 1;
+                if(_ahci_data.n_slots > depth) {
+                    _ahci_data.n_slots = depth;
+                }
+                _ahci_data.flags |= STORAGE_AHCI_FLAG_NCQ;
+            }
+            free(ident);
+
+            /* @note Offsets are currently 32-bit signed, so only the first 2 GiB of the
+             * drive is accessible. */
+            uint64_t size = (uint64_t)_ahci_data.n_sectors * STORAGE_AHCI_SECTOR_SIZE;
+            if(size > INT_MAX) {
+                size = INT_MAX - (INT_MAX % STORAGE_AHCI_SECTOR_SIZE);
+            }
+            storage->size = (size_t)size;
+
+#if (DEBUG_STORAGE_AHCI)
+            printf("storage_ahci: Disk at %08x:%u, %u sectors, %hhu slots%s%s\n",
+                   abar, port, _ahci_data.n_sectors, _ahci_data.n_slots,
+                   (_ahci_data.flags & STORAGE_AHCI_FLAG_LBA48) ? ", LBA48" : "",
+                   (_ahci_data.flags & STORAGE_AHCI_FLAG_NCQ)   ? ", NCQ"   : "");
+#endif
+
+            storage->block_size = STORAGE_AHCI_SECTOR_SIZE;
+            storage->buff_align = 2; /* PRDT data base addresses must be word aligned */
+            storage->data       = &_ahci_data;
+            storage->read       = _read;
+
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Poll a port register until the masked bits read as the given value
+ *
+ * @param adata AHCI storage data
+ * @param reg Port register offset
+ * @param mask Bits to check
+ * @param val Expected value of the masked bits
+ * @param ms Timeout in milliseconds
+ * @return int 0 on success, < 0 on timeout
+ */
+static int _ahci_wait_reg(const storage_ahci_data_t *adata, uint8_t reg, uint32_t mask, uint32_t val, uint32_t ms) {
+    time_ticks_t timeout;
+    time_offset(&timeout, ms);
+
+    while((AHCI_REG(adata->port, reg) & mask) != val) {
+        if(time_ispast(&timeout)) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Stop the port from processing its command list and receiving FISes
+ *
+ * @param adata AHCI storage data
+ * @return int 0 on success, < 0 on timeout
+ */
+static int _ahci_port_stop(storage_ahci_data_t *adata) {
+    AHCI_REG(adata->port, AHCI_PREG_CMD) &= ~AHCI_PCMD_ST;
+    if(_ahci_wait_reg(adata, AHCI_PREG_CMD, AHCI_PCMD_CR, 0, AHCI_TIMEOUT_PORT)) {
+        return -1;
+    }
+
+    AHCI_REG(adata->port, AHCI_PREG_CMD) &= ~AHCI_PCMD_FRE;
+    return _ahci_wait_reg(adata, AHCI_PREG_CMD, AHCI_PCMD_FR, 0, AHCI_TIMEOUT_PORT);
+}
+
+/**
+ * @brief Clear error state, and start the port processing its command list
+ *
+ * @param adata AHCI storage data, with command list and FIS area allocated
+ * @return int 0 on success, < 0 on timeout
+ */
+static int _ahci_port_run(storage_ahci_data_t *adata) {
+    AHCI_REG(adata->port, AHCI_PREG_SERR) = 0xFFFFFFFF;
+    AHCI_REG(adata->port, AHCI_PREG_IS)   = 0xFFFFFFFF;
+
+    AHCI_REG(adata->port, AHCI_PREG_CMD) |= AHCI_PCMD_FRE;
+    if(_ahci_wait_reg(adata, AHCI_PREG_TFD, AHCI_TFD_BSY | AHCI_TFD_DRQ, 0, AHCI_TIMEOUT_PORT)) {
+        return -1;
+    }
+    AHCI_REG(adata->port, AHCI_PREG_CMD) |= AHCI_PCMD_ST;
+
+    return 0;
+}
+
+/**
+ * @brief Take over the port from the BIOS, pointing it at our own command list
+ *
+ * @param adata AHCI storage data
+ * @return int 0 on success, else < 0
+ */
+static int _ahci_port_start(storage_ahci_data_t *adata) {
+    if(_ahci_port_stop(adata)) {
+        return -1;
+    }
+
+    adata->cmdlist = alloc(sizeof(storage_ahci_cmdhdr_t) * STORAGE_AHCI_MAX_SLOTS,
+                           ALLOC_FLAG_ALIGN(AHCI_ALIGN_CMDLIST));
+    adata->fis     = alloc(AHCI_FIS_SIZE, ALLOC_FLAG_ALIGN(AHCI_ALIGN_FIS));
+    adata->cmdtbl  = alloc(STORAGE_AHCI_CMDTBL_SIZE * adata->n_slots,
+                           ALLOC_FLAG_ALIGN(AHCI_ALIGN_CMDTBL));
+    if(!adata->cmdlist || !adata->fis || !adata->cmdtbl) {
+        panic("Could not allocate AHCI command structures!");
+    }
+
+    memset(adata->cmdlist, 0, sizeof(storage_ahci_cmdhdr_t) * STORAGE_AHCI_MAX_SLOTS);
+    memset(adata->fis,     0, AHCI_FIS_SIZE);
+    memset(adata->cmdtbl,  0, STORAGE_AHCI_CMDTBL_SIZE * adata->n_slots);
+    for(unsigned slot = 0; slot < adata->n_slots; slot++) {
+        adata->cmdlist[slot].ctba = (uintptr_t)adata->cmdtbl + (slot * STORAGE_AHCI_CMDTBL_SIZE);
+    }
+
+    AHCI_REG(adata->port, AHCI_PREG_CLB)  = (uintptr_t)adata->cmdlist;
+    AHCI_REG(adata->port, AHCI_PREG_CLBU) = 0;
+    AHCI_REG(adata->port, AHCI_PREG_FB)   = (uintptr_t)adata->fis;
+    AHCI_REG(adata->port, AHCI_PREG_FBU)  = 0;
+    /* Completion is polled */
+    AHCI_REG(adata->port, AHCI_PREG_IE)   = 0;
+
+    return _ahci_port_run(adata);
+}
+
+/**
+ * @brief Restart the port after a command failed, discarding all outstanding
+ * commands
+ *
+ * @param adata AHCI storage data
+ */
+static void _ahci_port_restart(storage_ahci_data_t *adata) {
+    adata->stats->resets++;
+    (void)_ahci_port_stop(adata);
+    (void)_ahci_port_run(adata);
+}
+
+/**
+ * @brief Fill in a command slot with a single-region command
+ *
+ * @param adata AHCI storage data
+ * @param slot Command slot to use
+ * @param buff Buffer to transfer into, must be 2-byte aligned
+ * @param size Number of bytes to transfer, at most AHCI_PRD_MAX_SIZE
+ * @return storage_ahci_fis_h2d_t* Command FIS, cleared, for the caller to fill in
+ */
+static storage_ahci_fis_h2d_t *_ahci_prepare(storage_ahci_data_t *adata, unsigned slot, void *buff, uint32_t size) {
+    storage_ahci_cmdtbl_t *tbl = (storage_ahci_cmdtbl_t *)adata->cmdlist[slot].ctba;
+
+    /* The PRD points straight at the destination, no intermediate buffer is
+     * involved regardless of where the destination lies. */
+    tbl->prdt[0].dba  = (uintptr_t)buff;
+    tbl->prdt[0].dbau = 0;
+    tbl->prdt[0].dbc  = size - 1;
+
+    adata->cmdlist[slot].flags = AHCI_CMDHDR_CFL(sizeof(storage_ahci_fis_h2d_t) / 4);
+    adata->cmdlist[slot].prdtl = 1;
+    adata->cmdlist[slot].prdbc = 0;
+
+    storage_ahci_fis_h2d_t *fis = (storage_ahci_fis_h2d_t *)tbl->cfis;
+    memset(fis, 0, sizeof(storage_ahci_fis_h2d_t));
+    fis->type  = AHCI_FIS_TYPE_H2D;
+    fis->flags = AHCI_FIS_H2D_CMD;
+
+    return fis;
+}
+
+/**
+ * @brief Wait for a set of command slots to complete
+ *
+ * @param adata AHCI storage data
+ * @param mask Command slots to wait on
+ * @return int 0 on success, < 0 on error or timeout
+ */
+static int _ahci_wait(storage_ahci_data_t *adata, uint32_t mask) {
+    time_ticks_t timeout;
+    time_offset(&timeout, AHCI_TIMEOUT_CMD);
+
+    /* Queued commands stay set in SACT until the device reports completion,
+     * non-queued commands only in CI. */
+    while((AHCI_REG(adata->port, AHCI_PREG_CI) | AHCI_REG(adata->port, AHCI_PREG_SACT)) & mask) {
+        if((AHCI_REG(adata->port, AHCI_PREG_IS) & AHCI_PIS_TFES) ||
+           (AHCI_REG(adata->port, AHCI_PREG_TFD) & AHCI_TFD_ERR)) {
+            return -1;
+        }
+        if(time_ispast(&timeout)) {
+            return -1;
+        }
+    }
+    _ahci_barrier();
+
+    return 0;
+}
+
+/**
+ * @brief Identify the device, using command slot 0
+ *
+ * @param adata AHCI storage data
+ * @param ident Where to store the 256 word identify data
+ * @return int 0 on success, else < 0
+ */
+static int _ahci_identify(storage_ahci_data_t *adata, uint16_t *ident) {
+    storage_ahci_fis_h2d_t *fis = _ahci_prepare(adata, 0, ident, 512);
+    fis->command = AHCI_CMD_IDENTIFY;
+
+    _ahci_barrier();
+    AHCI_REG(adata->port, AHCI_PREG_CI) = 1;
+
+    if(_ahci_wait(adata, 1)) {
+        _ahci_port_restart(adata);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Fill in a command slot to read a run of sectors
+ *
+ * @param adata AHCI storage data
+ * @param slot Command slot to use
+ * @param buff Buffer to read into, must be 2-byte aligned
+ * @param lba First sector to read
+ * @param count Number of sectors to read, at most STORAGE_AHCI_CHUNK
+ * @return int 0 on success, < 0 if the sectors cannot be addressed
+ */
+static int _ahci_read_command(storage_ahci_data_t *adata, unsigned slot, void *buff, uint32_t lba, uint32_t count) {
+    int lba48 = ((lba + count) > 0x0FFFFFFF);
+    if(lba48 && !(adata->flags & STORAGE_AHCI_FLAG_LBA48)) {
+        return -1;
+    }
+
+    storage_ahci_fis_h2d_t *fis = _ahci_prepare(adata, slot, buff, count * STORAGE_AHCI_SECTOR_SIZE);
+
+    adata->stats->xfers++;
+    adata->stats->read += count * STORAGE_AHCI_SECTOR_SIZE;
+
+    fis->lba0   = (uint8_t)lba;
+    fis->lba1   = (uint8_t)(lba >> 8);
+    fis->lba2   = (uint8_t)(lba >> 16);
+    fis->device = AHCI_DEVICE_LBA;
+
+    if(adata->flags & STORAGE_AHCI_FLAG_NCQ) {
+        /* Queued commands carry the count in the features register, and the
+         * tag in the count register */
+        fis->command      = AHCI_CMD_READ_FPDMA_QUEUED;
+        fis->lba3         = (uint8_t)(lba >> 24);
+        fis->features     = (uint8_t)count;
+        fis->features_exp = (uint8_t)(count >> 8);
+        fis->count        = slot << 3;
+    } else if(adata->flags & STORAGE_AHCI_FLAG_LBA48) {
+        fis->command = AHCI_CMD_READ_DMA_EXT;
+        fis->lba3    = (uint8_t)(lba >> 24);
+        fis->count   = count;
+    } else {
+        fis->command = AHCI_CMD_READ_DMA;
+        fis->device |= (lba >> 24) & 0x0F;
+        fis->count   = count;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Read a run of sectors, split across as many command slots as needed,
+ * retrying on error
+ *
+ * All commands are issued together, so the HBA and device can process them
+ * back-to-back, or in any order the device prefers when NCQ is in use.
+ *
+ * @param adata AHCI storage data
+ * @param buff Buffer to read into, must be 2-byte aligned
+ * @param lba First sector to read
+ * @param count Number of sectors to read, at most `n_slots * STORAGE_AHCI_CHUNK`
+ * @return int 0 on success, else < 0
+ */
+static int _ahci_xfer(storage_ahci_data_t *adata, void *buff, uint32_t lba, uint32_t count) {
+    for(unsigned attempt = 0; attempt < STORAGE_AHCI_ATTEMPTS; attempt++) {
+        if(attempt) {
+#if (DEBUG_STORAGE_AHCI)
+            printf(" RETRY");
+#endif
+            adata->stats->retries++;
+        }
+
+        uint32_t mask = 0;
+        for(unsigned slot = 0; (slot * STORAGE_AHCI_CHUNK) < count; slot++) {
+            uint32_t off = slot * STORAGE_AHCI_CHUNK;
+            uint32_t run = ((count - off) > STORAGE_AHCI_CHUNK) ? STORAGE_AHCI_CHUNK : (count - off);
+            if(_ahci_read_command(adata, slot, buff + (off * STORAGE_AHCI_SECTOR_SIZE), lba + off, run)) {
+                adata->stats->failures++;
+                return -1;
+            }
+            mask |= (1UL << slot);
+        }
+
+#if (DEBUG_STORAGE_AHCI)
+        printf(" [%u+%u/%08x]", lba, count, mask);
+#endif
+
+        _ahci_barrier();
+        if(adata->flags & STORAGE_AHCI_FLAG_NCQ) {
+            AHCI_REG(adata->port, AHCI_PREG_SACT) = mask;
+        }
+        AHCI_REG(adata->port, AHCI_PREG_CI) = mask;
+
+        if(!_ahci_wait(adata, mask)) {
+            status_working(WORKING_STATUS_WORKING);
+            return 0;
+        }
+
+        /* An error aborts every outstanding command, so the whole batch is
+         * reissued */
+        _ahci_port_restart(adata);
+    }
+
+    adata->stats->failures++;
+    status_working(WORKING_STATUS_WORKING);
+
+    return -1;
+}
+
+static ssize_t _read(storage_hand_t *storage, void *buff, off_t offset, size_t size) {
+#if (DEBUG_STORAGE_AHCI)
+    printf("_ahci_read(..., %p, %5d, %4d)", buff, offset, size);
+#endif
+
+    storage_ahci_data_t *adata = (storage_ahci_data_t *)storage->data;
+
+    if((offset % STORAGE_AHCI_SECTOR_SIZE) || (size % STORAGE_AHCI_SECTOR_SIZE)) {
+        /* Currently only support sector-aligned reads */
+        panic("Address or size not aligned to sector count!");
+    }
+    if(offset < 0) {
+        panic("Negative offset!");
+    }
+    if((uintptr_t)buff & 1) {
+        panic("AHCI buffer not 2-byte aligned!");
+    }
+
+    uint32_t lba   = offset / STORAGE_AHCI_SECTOR_SIZE;
+    uint32_t count = size   / STORAGE_AHCI_SECTOR_SIZE;
+    uint32_t batch = adata->n_slots * STORAGE_AHCI_CHUNK;
+    while(count) {
+        uint32_t run = (count > batch) ? batch : count;
+        if(_ahci_xfer(adata, buff, lba, run)) {
+#if (DEBUG_STORAGE_AHCI)
+            printf(" FAIL [retries: %u, resets: %u, failures: %u]\n",
+                   adata->stats->retries, adata->stats->resets, adata->stats->failures);
+#endif
+            return -1;
+        }
+
+        buff  += run * STORAGE_AHCI_SECTOR_SIZE;
+        lba   += run;
+        count -= run;
+    }
+
+#if (DEBUG_STORAGE_AHCI)
+    printf(" OK\n");
+#endif
+
+    return (ssize_t)size;
+}
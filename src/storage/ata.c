@@ -0,0 +1,569 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "intr/interrupts.h"
+#include "io/ioport.h"
+#include "io/output.h"
+#include "pci/pci.h"
+#include "storage/ata.h"
+#include "storage/bounce.h"
+#include "time/time.h"
+
+/* @note since we currently allow only a single device open at a time, having
+ * this statically declared should be fine. */
+static storage_ata_data_t _ata_data = { 0 };
+
+#define ATA_TIMEOUT_IDENTIFY (1000) /**< Timeout for a device to answer IDENTIFY, in ms */
+#define ATA_TIMEOUT_CMD      (5000) /**< Timeout for a data block to become ready, in ms */
+
+static ssize_t _read(storage_hand_t *storage, void *buff, off_t offset, size_t size);
+static void    _ata_int_handler(uint8_t int_id, uint32_t errno, void *data);
+static int     _ata_identify(storage_ata_data_t *adata, uint16_t *ident);
+static void    _ata_set_multiple(storage_ata_data_t *adata, const uint16_t *ident);
+#ifdef CONFIG_STORAGE_ATA_DMA
+static void    _ata_dma_init(storage_ata_data_t *adata, const uint16_t *ident);
+#endif
+
+int storage_ata_init(storage_hand_t *storage, uint8_t index) {
+    static const struct {
+        uint16_t base;
+        uint16_t ctrl;
+        uint8_t  int_id;
+    } _channels[] = {
+        { ATA_PRIMARY_BASE,   ATA_PRIMARY_CTRL,   INT_ID_ATAPRIMARY   },
+        { ATA_SECONDARY_BASE, ATA_SECONDARY_CTRL, INT_ID_ATASECONDARY }
+    };
+
+    memset(storage, 0, sizeof(storage_hand_t));
+    memset(&_ata_data, 0, sizeof(_ata_data));
+    _ata_data.stats = &storage->stats;
+
+    uint16_t ident[256];
+
+    for(unsigned i = 0; i < (sizeof(_channels) / sizeof(_channels[0])) * 2; i++) {
+        _ata_data.base   = _channels[i / 2].base;
+        _ata_data.ctrl   = _channels[i / 2].ctrl;
+        _ata_data.int_id = _channels[i / 2].int_id;
+        _ata_data.drive  = i % 2;
+
+        if(_ata_identify(&_ata_data, ident)) {
+            continue;
+        }
+        if(index--) {
+            continue;
+        }
+
+        if(!(ident[ATA_IDENT_CAPS] & (1U << 9))) {
+            printf("storage_ata: Disk does not support LBA\n");
+            return -1;
+        }
+
+        _ata_data.n_sectors = ident[ATA_IDENT_LBA28_SECTORS] |
+                              ((uint32_t)ident[ATA_IDENT_LBA28_SECTORS + 1] << 16);
+        if(ident[ATA_IDENT_CMDSET2] & (1U << 10)) {
+            _ata_data.flags |= STORAGE_ATA_FLAG_LBA48;
+            /* Only the first 2^32 sectors are usable regardless */
+            if(ident[ATA_IDENT_LBA48_SECTORS + 2] || ident[ATA_IDENT_LBA48_SECTORS + 3]) {
+                _ata_data.n_sectors = 0xFFFFFFFF;
+            } else {
+                _ata_data.n_sectors = ident[ATA_IDENT_LBA48_SECTORS] |
+                                      ((uint32_t)ident[ATA_IDENT_LBA48_SECTORS + 1] << 16);
+            }
+        }
+
+        /* @note Offsets are currently 32-bit signed, so only the first 2 GiB of the
+         * drive is accessible. */
+        uint64_t size = (uint64_t)_ata_data.n_sectors * STORAGE_ATA_SECTOR_SIZE;
+        if(size > INT_MAX) {
+            size = INT_MAX - (INT_MAX % STORAGE_ATA_SECTOR_SIZE);
+        }
+        storage->size = (size_t)size;
+
+        interrupt_register(_ata_data.int_id, _ata_int_handler, &_ata_data);
+        interrupt_enable(INT_ID_CASCADE);
+        interrupt_enable(_ata_data.int_id);
+        /* Enable device interrupts */
+        outb(ATA_REG_DEVCTRL(_ata_data.ctrl), 0x00);
+
+        _ata_set_multiple(&_ata_data, ident);
+#ifdef CONFIG_STORAGE_ATA_DMA
+        _ata_dma_init(&_ata_data, ident);
+#endif
+
+#if (DEBUG_STORAGE_ATA)
+        printf("storage_ata: Disk %hhu at %03hx:%hhu, %u sectors, %hu per block%s%s\n",
+               i, _ata_data.base, _ata_data.drive, _ata_data.n_sectors, _ata_data.multiple,
+               (_ata_data.flags & STORAGE_ATA_FLAG_LBA48) ? ", LBA48" : "",
+               (_ata_data.flags & STORAGE_ATA_FLAG_DMA)   ? ", DMA"   : "");
+#endif
+
+        storage->block_size = STORAGE_ATA_SECTOR_SIZE;
+        storage->data       = &_ata_data;
+        storage->read       = _read;
+
+        return 0;
+    }
+
+    return -1;
+}
+
+static void _ata_int_handler(uint8_t int_id, uint32_t errno, void *data) {
+    (void)int_id;
+    (void)errno;
+    ((storage_ata_data_t *)data)->irq = 1;
+}
+
+/**
+ * @brief Wait 400 ns for the status register to become valid, by reading the
+ * alternate status register
+ *
+ * @param adata ATA storage data
+ */
+static inline void _ata_delay(const storage_ata_data_t *adata) {
+    for(unsigned i = 0; i < 4; i++) {
+        (void)inb(ATA_REG_ALTSTATUS(adata->ctrl));
+    }
+}
+
+/**
+ * @brief Poll until the device is no longer busy
+ *
+ * @param adata ATA storage data
+ * @param ms Timeout in milliseconds
+ * @return int Status register, or < 0 on timeout
+ */
+static int _ata_wait_busy(const storage_ata_data_t *adata, uint32_t ms) {
+    time_ticks_t timeout;
+    time_offset(&timeout, ms);
+
+    uint8_t status;
+    while((status = inb(ATA_REG_ALTSTATUS(adata->ctrl))) & ATA_STATUS_BSY) {
+        if(time_ispast(&timeout)) {
+            return -1;
+        }
+    }
+
+    return status;
+}
+
+/**
+ * @brief Wait for the device to raise an interrupt, and acknowledge it
+ *
+ * @param adata ATA storage data
+ * @return int Status register, or < 0 on timeout
+ */
+static int _ata_wait_irq(storage_ata_data_t *adata) {
+    time_ticks_t timeout;
+    time_offset(&timeout, ATA_TIMEOUT_CMD);
+
+    while(!adata->irq) {
+        if(time_ispast(&timeout)) {
+            return -1;
+        }
+        asm volatile("hlt");
+    }
+    adata->irq = 0;
+
+    if(_ata_wait_busy(adata, ATA_TIMEOUT_CMD) < 0) {
+        return -1;
+    }
+
+    /* Reading the status register acknowledges the interrupt */
+    return inb(ATA_REG_STATUS(adata->base));
+}
+
+/**
+ * @brief Select the device, and wait for it to be ready for a command
+ *
+ * @param adata ATA storage data
+ * @param lba_high LBA bits 24-27, for 28-bit commands
+ * @return int 0 on success, < 0 on timeout
+ */
+static int _ata_select(const storage_ata_data_t *adata, uint8_t lba_high) {
+    outb(ATA_REG_DEVICE(adata->base), ATA_DEVICE_OBS | ATA_DEVICE_LBA |
+                                      ATA_DEVICE_DEV(adata->drive) | (lba_high & 0x0F));
+    _ata_delay(adata);
+
+    return (_ata_wait_busy(adata, ATA_TIMEOUT_CMD) < 0) ? -1 : 0;
+}
+
+/**
+ * @brief Identify ATA device, interrupts are not used as the channel handler
+ * may not be registered yet
+ *
+ * @param adata ATA storage data, with the channel and drive populated
+ * @param ident Where to store the 256 word identify data
+ * @return int 0 if an ATA disk is present, else < 0
+ */
+static int _ata_identify(storage_ata_data_t *adata, uint16_t *ident) {
+    /* A floating bus reads as 0xFF */
+    if(inb(ATA_REG_STATUS(adata->base)) == 0xFF) {
+        return -1;
+    }
+
+    outb(ATA_REG_DEVCTRL(adata->ctrl), ATA_DEVCTRL_NIEN);
+    outb(ATA_REG_DEVICE(adata->base), ATA_DEVICE_OBS | ATA_DEVICE_DEV(adata->drive));
+    _ata_delay(adata);
+
+    outb(ATA_REG_COUNT(adata->base), 0);
+    outb(ATA_REG_LBA0(adata->base),  0);
+    outb(ATA_REG_LBA1(adata->base),  0);
+    outb(ATA_REG_LBA2(adata->base),  0);
+    outb(ATA_REG_COMMAND(adata->base), ATA_CMD_IDENTIFY);
+    _ata_delay(adata);
+
+    if(inb(ATA_REG_STATUS(adata->base)) == 0x00) {
+        /* No device */
+        return -1;
+    }
+
+    int status = _ata_wait_busy(adata, ATA_TIMEOUT_IDENTIFY);
+    if(status < 0) {
+        return -1;
+    }
+
+    /* ATAPI and SATA devices abort IDENTIFY and leave a signature in the LBA
+     * registers, which ATA devices must leave clear. */
+    if(inb(ATA_REG_LBA1(adata->base)) || inb(ATA_REG_LBA2(adata->base))) {
+        return -1;
+    }
+
+    time_ticks_t timeout;
+    time_offset(&timeout, ATA_TIMEOUT_IDENTIFY);
+    while(!(status & (ATA_STATUS_DRQ | ATA_STATUS_ERR))) {
+        if(time_ispast(&timeout)) {
+            return -1;
+        }
+        status = inb(ATA_REG_ALTSTATUS(adata->ctrl));
+    }
+    if(status & ATA_STATUS_ERR) {
+        return -1;
+    }
+
+    insw(ATA_REG_DATA(adata->base), ident, 256);
+    (void)inb(ATA_REG_STATUS(adata->base));
+
+    if(ident[ATA_IDENT_CONFIG] & (1U << 15)) {
+        /* Not an ATA device */
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Configure the largest supported block size for READ MULTIPLE
+ *
+ * @param adata ATA storage data
+ * @param ident Identify data
+ */
+static void _ata_set_multiple(storage_ata_data_t *adata, const uint16_t *ident) {
+    uint8_t max = ident[ATA_IDENT_MULTIPLE_MAX] & 0xFF;
+
+    adata->multiple = 1;
+    if(max <= 1) {
+        return;
+    }
+
+    if(_ata_select(adata, 0)) {
+        return;
+    }
+
+    adata->irq = 0;
+    outb(ATA_REG_COUNT(adata->base), max);
+    outb(ATA_REG_COMMAND(adata->base), ATA_CMD_SET_MULTIPLE);
+
+    int status = _ata_wait_irq(adata);
+    if((status < 0) || (status & (ATA_STATUS_ERR | ATA_STATUS_DF))) {
+        return;
+    }
+
+    adata->multiple = max;
+}
+
+/**
+ * @brief Reset both devices on the channel, after an error
+ *
+ * @param adata ATA storage data
+ */
+static void _ata_reset(storage_ata_data_t *adata) {
+    outb(ATA_REG_DEVCTRL(adata->ctrl), ATA_DEVCTRL_SRST);
+    time_delay(1);
+    outb(ATA_REG_DEVCTRL(adata->ctrl), 0x00);
+    time_delay(2);
+    (void)_ata_wait_busy(adata, ATA_TIMEOUT_CMD);
+}
+
+/**
+ * @brief Issue a read command for a run of sectors
+ *
+ * @param adata ATA storage data
+ * @param lba First sector to read
+ * @param count Number of sectors to read, at most STORAGE_ATA_MAX_SECTORS
+ * @param cmd 28-bit command to issue
+ * @param cmd_ext 48-bit command to issue, if the run lies beyond the 28-bit range
+ * @return int 0 on success, else < 0
+ */
+static int _ata_command(storage_ata_data_t *adata, uint32_t lba, uint32_t count, uint8_t cmd, uint8_t cmd_ext) {
+    int lba48 = ((lba + count) > 0x0FFFFFFF);
+    if(lba48 && !(adata->flags & STORAGE_ATA_FLAG_LBA48)) {
+        return -1;
+    }
+
+#if (DEBUG_STORAGE_ATA)
+    printf(" [%u+%u%s]", lba, count, lba48 ? " EXT" : "");
+#endif
+
+    if(_ata_select(adata, lba48 ? 0 : (lba >> 24))) {
+        return -1;
+    }
+
+    if(lba48) {
+        /* High order bytes are written first */
+        outb(ATA_REG_COUNT(adata->base), (uint8_t)(count >> 8));
+        outb(ATA_REG_LBA0(adata->base),  (uint8_t)(lba >> 24));
+        outb(ATA_REG_LBA1(adata->base),  0);
+        outb(ATA_REG_LBA2(adata->base),  0);
+        cmd = cmd_ext;
+    }
+    /* A count of 0 represents 256 sectors in 28-bit mode */
+    outb(ATA_REG_COUNT(adata->base), (uint8_t)count);
+    outb(ATA_REG_LBA0(adata->base),  (uint8_t)lba);
+    outb(ATA_REG_LBA1(adata->base),  (uint8_t)(lba >> 8));
+    outb(ATA_REG_LBA2(adata->base),  (uint8_t)(lba >> 16));
+
+    adata->irq = 0;
+    outb(ATA_REG_COMMAND(adata->base), cmd);
+
+    return 0;
+}
+
+/**
+ * @brief Make a single attempt at reading a run of sectors using PIO
+ *
+ * @param adata ATA storage data
+ * @param buff Buffer to read into
+ * @param lba First sector to read
+ * @param count Number of sectors to read, at most STORAGE_ATA_MAX_SECTORS
+ * @return int 0 on success, else < 0
+ */
+static int _ata_pio_read_sectors(storage_ata_data_t *adata, void *buff, uint32_t lba, uint32_t count) {
+    int ret;
+    if(adata->multiple > 1) {
+        ret = _ata_command(adata, lba, count, ATA_CMD_READ_MULTIPLE, ATA_CMD_READ_MULTIPLE_EXT);
+    } else {
+        ret = _ata_command(adata, lba, count, ATA_CMD_READ_SECTORS, ATA_CMD_READ_SECTORS_EXT);
+    }
+    if(ret) {
+        return -1;
+    }
+
+    /* One interrupt is raised per block of `multiple` sectors */
+    while(count) {
+        int status = _ata_wait_irq(adata);
+        if((status < 0) ||
+           (status & (ATA_STATUS_ERR | ATA_STATUS_DF)) ||
+           !(status & ATA_STATUS_DRQ)) {
+            return -1;
+        }
+
+        uint32_t block = (count > adata->multiple) ? adata->multiple : count;
+        insw(ATA_REG_DATA(adata->base), buff, (block * STORAGE_ATA_SECTOR_SIZE) / 2);
+
+        buff  += block * STORAGE_ATA_SECTOR_SIZE;
+        count -= block;
+    }
+
+    return 0;
+}
+
+#ifdef CONFIG_STORAGE_ATA_DMA
+/**
+ * @brief Make a single attempt at reading a run of sectors using bus-master DMA
+ *
+ * The PRD table points straight at the destination, so no intermediate
+ * buffer is involved regardless of where the destination lies.
+ *
+ * @param adata ATA storage data
+ * @param buff Buffer to read into, must be 2-byte aligned
+ * @param lba First sector to read
+ * @param count Number of sectors to read, at most STORAGE_ATA_MAX_SECTORS
+ * @return int 0 on success, else < 0
+ */
+static int _ata_dma_read_sectors(storage_ata_data_t *adata, void *buff, uint32_t lba, uint32_t count) {
+    /* Each PRD region may not cross a 64 KiB boundary */
+    uintptr_t addr = (uintptr_t)buff;
+    uint32_t  left = count * STORAGE_ATA_SECTOR_SIZE;
+    unsigned  n    = 0;
+    while(left) {
+        uint32_t chunk = ATA_PRD_BOUNDARY - (addr % ATA_PRD_BOUNDARY);
+        if(chunk > left) {
+            chunk = left;
+        }
+
+        /* A size of 0 represents 64 KiB */
+        adata->prdt[n].addr  = addr;
+        adata->prdt[n].size  = (uint16_t)chunk;
+        adata->prdt[n].flags = 0;
+
+        addr += chunk;
+        left -= chunk;
+        n++;
+    }
+    adata->prdt[n - 1].flags = ATA_PRD_FLAG_EOT;
+
+    outb(ATA_BM_REG_COMMAND(adata->bmide), 0x00);
+    outb(ATA_BM_REG_STATUS(adata->bmide),  ATA_BM_STATUS_ERROR | ATA_BM_STATUS_IRQ);
+    outl(ATA_BM_REG_PRDT(adata->bmide),    (uint32_t)adata->prdt);
+    outb(ATA_BM_REG_COMMAND(adata->bmide), ATA_BM_CMD_READ);
+
+    if(_ata_command(adata, lba, count, ATA_CMD_READ_DMA, ATA_CMD_READ_DMA_EXT)) {
+        return -1;
+    }
+
+    outb(ATA_BM_REG_COMMAND(adata->bmide), ATA_BM_CMD_READ | ATA_BM_CMD_START);
+
+    /* A single interrupt is raised once the entire transfer is complete */
+    int     status   = _ata_wait_irq(adata);
+    uint8_t bmstatus = inb(ATA_BM_REG_STATUS(adata->bmide));
+
+    outb(ATA_BM_REG_COMMAND(adata->bmide), 0x00);
+    outb(ATA_BM_REG_STATUS(adata->bmide),  ATA_BM_STATUS_ERROR | ATA_BM_STATUS_IRQ);
+
+    if((status < 0) ||
+       (status & (ATA_STATUS_ERR | ATA_STATUS_DF)) ||
+       (bmstatus & (ATA_BM_STATUS_ERROR | ATA_BM_STATUS_ACTIVE))) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Enable bus-master DMA, if supported by both the disk and the IDE
+ * controller owning the legacy ports
+ *
+ * @param adata ATA storage data
+ * @param ident Identify data
+ */
+static void _ata_dma_init(storage_ata_data_t *adata, const uint16_t *ident) {
+    if(!(ident[ATA_IDENT_CAPS] & (1U << 8))) {
+        return;
+    }
+
+    unsigned   channel = (adata->base == ATA_PRIMARY_BASE) ? 0 : 1;
+    pci_addr_t pci;
+    for(unsigned i = 0; !pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_STORAGE_IDE, i, &pci); i++) {
+        uint8_t progif = pci_read8(pci, PCI_REG_PROGIF);
+        if(progif & ATA_PROGIF_NATIVE(channel)) {
+            /* Channel is not using the legacy ports */
+            continue;
+        }
+        if(!(progif & ATA_PROGIF_BUSMASTER)) {
+            return;
+        }
+
+        uint32_t bmide = pci_bar(pci, ATA_BM_BAR);
+        if(!bmide) {
+            return;
+        }
+        pci_enable(pci, PCI_COMMAND_IO | PCI_COMMAND_MASTER);
+
+        adata->bmide  = bmide + (channel * ATA_BM_CHANNEL_SIZE);
+        adata->prdt   = storage_bounce_alloc(sizeof(storage_ata_prd_t) * STORAGE_ATA_PRD_CNT, ATA_PRD_BOUNDARY);
+        adata->flags |= STORAGE_ATA_FLAG_DMA;
+        return;
+    }
+}
+#endif /* CONFIG_STORAGE_ATA_DMA */
+
+/**
+ * @brief Read a run of sectors, retrying on error
+ *
+ * @param adata ATA storage data
+ * @param buff Buffer to read into
+ * @param lba First sector to read
+ * @param count Number of sectors to read, at most STORAGE_ATA_MAX_SECTORS
+ * @return int 0 on success, else < 0
+ */
+static int _ata_xfer(storage_ata_data_t *adata, void *buff, uint32_t lba, uint32_t count) {
+    for(unsigned attempt = 0; attempt < STORAGE_ATA_ATTEMPTS; attempt++) {
+        if(attempt) {
+#if (DEBUG_STORAGE_ATA)
+            printf(" RETRY");
+#endif
+            adata->stats->retries++;
+            /* The first failure is retried as-is, as it is often transient */
+            if(attempt > 1) {
+                adata->stats->resets++;
+                _ata_reset(adata);
+            }
+        }
+
+        adata->stats->xfers++;
+        adata->stats->read += count * STORAGE_ATA_SECTOR_SIZE;
+
+        int ret;
+#ifdef CONFIG_STORAGE_ATA_DMA
+        if((adata->flags & STORAGE_ATA_FLAG_DMA) &&
+           !((uintptr_t)buff & 1)) {
+            ret = _ata_dma_read_sectors(adata, buff, lba, count);
+        } else {
+            ret = _ata_pio_read_sectors(adata, buff, lba, count);
+        }
+#else
+        ret = _ata_pio_read_sectors(adata, buff, lba, count);
+#endif
+
+        if(!ret) {
+            status_working(WORKING_STATUS_WORKING);
+            return 0;
+        }
+    }
+
+    adata->stats->failures++;
+    status_working(WORKING_STATUS_WORKING);
+
+    return -1;
+}
+
+static ssize_t _read(storage_hand_t *storage, void *buff, off_t offset, size_t size) {
+#if (DEBUG_STORAGE_ATA)
+    printf("_ata_read(..., %p, %5d, %4d)", buff, offset, size);
+#endif
+
+    storage_ata_data_t *adata = (storage_ata_data_t *)storage->data;
+
+    if((offset % STORAGE_ATA_SECTOR_SIZE) || (size % STORAGE_ATA_SECTOR_SIZE)) {
+        /* Currently only support sector-aligned reads */
+        panic("Address or size not aligned to sector count!");
+    }
+    if(offset < 0) {
+        panic("Negative offset!");
+    }
+
+    /* PIO transfers go through the CPU, so any destination is reachable */
+    uint32_t lba   = offset / STORAGE_ATA_SECTOR_SIZE;
+    uint32_t count = size   / STORAGE_ATA_SECTOR_SIZE;
+    while(count) {
+        uint32_t run = (count > STORAGE_ATA_MAX_SECTORS) ? STORAGE_ATA_MAX_SECTORS : count;
+        if(_ata_xfer(adata, buff, lba, run)) {
+#if (DEBUG_STORAGE_ATA)
+            printf(" FAIL [retries: %u, resets: %u, failures: %u]\n",
+                   adata->stats->retries, adata->stats->resets, adata->stats->failures);
+#endif
+            return -1;
+        }
+
+        buff  += run * STORAGE_ATA_SECTOR_SIZE;
+        lba   += run;
+        count -= run;
+    }
+
+#if (DEBUG_STORAGE_ATA)
+    printf(" OK\n");
+#endif
+
+    return (ssize_t)size;
+}
+
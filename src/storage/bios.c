@@ -1,108 +1,569 @@
+#include <stddef.h>
 #include <string.h>
 
 #include "bios/bios.h"
 #include "io/output.h"
+#include "mm/alloc.h"
 #include "storage/bios.h"
+#include "storage/fs/fat.h"
 
 /* @note since we currently allow only a single device open at a time, having
  * this statically declared should be fine. */
 static storage_bios_data_t _bios_data = { 0 };
 
+/* @note These are passed to the BIOS as DS:SI with DS = 0, so they are placed
+ * in the .realmode section, which the linker script keeps below 64 KiB. */
+static storage_bios_dap_t        _edd_dap    __attribute__((section(".realmode.edd_dap")));
+static storage_bios_edd_params_t _edd_params __attribute__((section(".realmode.edd_params")));
+
 static ssize_t _read(storage_hand_t *storage, void *buff, off_t offset, size_t size);
+static int     _edd_init(storage_hand_t *storage, storage_bios_data_t *bdata);
+static int     _edd_read_sectors(storage_bios_data_t *bdata, void *buff, uint32_t lba, uint8_t count);
+static void    _floppy_geometry(storage_hand_t *storage, storage_bios_data_t *bdata);
+static int     _bios_xfer(void *data, void *buff, uint32_t lba, uint32_t count);
+static void    _bios_disk_call(storage_bios_data_t *bdata, bios_call_t *call);
+#ifdef CONFIG_STORAGE_BIOS_TRACKCACHE
+static void    _tcache_init(storage_bios_data_t *bdata);
+#endif
 
 int storage_bios_init(storage_hand_t *storage, uint8_t bios_dev) {
     memset(storage, 0, sizeof(storage_hand_t));
+    memset(&_bios_data, 0, sizeof(_bios_data));
+    _bios_data.stats = &storage->stats;
+
+    _bios_data.bios_id = bios_dev;
 
     if(bios_dev < 0x80) {
-        /* INT 0x13, AH = 0x08 supposedly can report incorrect values for a
-         * floppy disk. Assuming a standard 1.44MB disk geometry here. */
-        _bios_data.sectors_per_track = 18;
-        _bios_data.n_heads           = 2;
-        storage->size                = 2880 * 512;
+        _bios_data.sector_size = 512;
+        /* Single-sector transfers until the geometry is known */
+        _bios_data.xfer.max    = 1;
     } else {
-        /* @todo */
-        /*bios_call_t call;
-        memset(&call, 0, sizeof(bios_call_t));
-        call.int_n = 0x13;
-        call.ax    = 0x0800;
-        bios_call(&call);*/
+        if(_edd_init(storage, &_bios_data)) {
+            return -1;
+        }
+        /* A transfer goes through a single segment:offset, with an offset
+         * of up to 15, so must not exceed 64 KiB less 16 bytes */
+        uint32_t max = (0x10000 - 0x10) / _bios_data.sector_size;
+        _bios_data.xfer.max = (max < STORAGE_BIOS_EDD_MAX_SECTORS) ? max : STORAGE_BIOS_EDD_MAX_SECTORS;
+    }
+    _bios_data.xfer.cur = _bios_data.xfer.max;
+
+    /* The floppy controller uses ISA DMA, the BIOS handles hard disks in
+     * whichever way it sees fit. In either case, real-mode segment:offset
+     * addressing must be used. */
+    if(storage_bounce_init(&_bios_data.bounce, CONFIG_STORAGE_BIOS_BOUNCE_SIZE * 1024,
+                           STORAGE_BOUNCE_LIMIT_REALMODE,
+                           (bios_dev < 0x80) ? STORAGE_BOUNCE_BOUNDARY_DMA : 0,
+                           _bios_data.sector_size)) {
         return -1;
     }
+    _bios_data.bounce.xfer = _bios_xfer;
+    _bios_data.bounce.data = &_bios_data;
+
+    if(bios_dev < 0x80) {
+        _floppy_geometry(storage, &_bios_data);
+        _bios_data.xfer.max = _bios_data.sectors_per_track;
+        _bios_data.xfer.cur = _bios_data.xfer.max;
+    }
+
+#ifdef CONFIG_STORAGE_BIOS_TRACKCACHE
+    if(!(_bios_data.flags & STORAGE_BIOS_FLAG_EDD)) {
+        _tcache_init(&_bios_data);
+    }
+#endif
+
+    storage->block_size = _bios_data.sector_size;
+    storage->data       = &_bios_data;
+    storage->read       = _read;
+
+    return 0;
+}
+
+void *storage_bios_first_sector(uint8_t bios_dev) {
+    /* A throwaway handle, so the driver's own state is left untouched */
+    storage_hand_t      storage;
+    storage_bios_data_t bdata;
+    memset(&bdata, 0, sizeof(bdata));
+    bdata.stats   = &storage.stats;
+    bdata.bios_id = bios_dev;
+
+    if(_edd_init(&storage, &bdata)) {
+        return NULL;
+    }
+
+    void *buff = alloc(bdata.sector_size, 0);
+    if(_edd_read_sectors(&bdata, buff, 0, 1)) {
+        free(buff);
+        return NULL;
+    }
+
+    return buff;
+}
+
+/**
+ * @brief Check for INT 13h extensions support, and retrieve drive parameters
+ *
+ * @param storage Storage handle
+ * @param bdata BIOS storage data
+ * @return int 0 on success, < 0 if extensions are not usable for this drive
+ */
+static int _edd_init(storage_hand_t *storage, storage_bios_data_t *bdata) {
+    bios_call_t call;
+    memset(&call, 0, sizeof(bios_call_t));
+
+    /* Installation check */
+    call.int_n = 0x13;
+    call.ah    = 0x41;
+    call.bx    = 0x55AA;
+    call.dl    = bdata->bios_id;
+    _bios_disk_call(bdata, &call);
+
+    if((call.eflags & EFLAGS_CF) ||
+       (call.bx != 0xAA55)       ||
+       !(call.cx & 0x0001)) {
+        /* No extensions, or disk address packet access not supported */
+        printf("storage_bios: Drive %02hhx does not support INT 13h extensions\n", bdata->bios_id);
+        return -1;
+    }
+
+    /* Get drive parameters */
+    memset(&_edd_params, 0, sizeof(_edd_params));
+    _edd_params.size = sizeof(_edd_params);
+
+    memset(&call, 0, sizeof(bios_call_t));
+    call.int_n = 0x13;
+    call.ah    = 0x48;
+    call.dl    = bdata->bios_id;
+    call.si    = (uint16_t)(uintptr_t)&_edd_params;
+    _bios_disk_call(bdata, &call);
+
+    if(call.eflags & EFLAGS_CF) {
+        printf("storage_bios: Could not get parameters for drive %02hhx\n", bdata->bios_id);
+        return -1;
+    }
+
+    bdata->flags      |= STORAGE_BIOS_FLAG_EDD;
+    bdata->sector_size = _edd_params.sector_size ? _edd_params.sector_size : 512;
+
+    /* @note Offsets are currently 32-bit signed, so only the first 2 GiB of the
+     * drive is accessible. */
+    uint64_t size = _edd_params.total_sectors * bdata->sector_size;
+    if(size > INT_MAX) {
+        size = INT_MAX - (INT_MAX % bdata->sector_size);
+    }
+    storage->size = (size_t)size;
 
-    storage->data = &_bios_data;
-    storage->read = _read;
+#if (DEBUG_STORAGE_BIOS)
+    printf("storage_bios: EDD drive %02hhx, %u sectors of %hu bytes\n",
+           bdata->bios_id, (uint32_t)_edd_params.total_sectors, bdata->sector_size);
+#endif
 
     return 0;
 }
 
-static void _floppy_reset(uint8_t bios_id) {
+/**
+ * @brief Make an INT 13h call, counting it in the device statistics
+ *
+ * @param bdata BIOS storage data
+ * @param call BIOS call parameters
+ */
+static void _bios_disk_call(storage_bios_data_t *bdata, bios_call_t *call) {
+    bdata->stats->bios_calls++;
+    bios_call(call);
+}
+
+static void _bios_reset(storage_bios_data_t *bdata) {
     bios_call_t call;
     memset(&call, 0, sizeof(bios_call_t));
 
     call.int_n = 0x13;
     call.ax    = 0x00;
-    call.dl    = bios_id;
-    bios_call(&call);
+    call.dl    = bdata->bios_id;
+    _bios_disk_call(bdata, &call);
 }
 
-static int _floppy_read_sector(storage_bios_data_t *bdata, void *buff, off_t offset) {
-    if((uint32_t)buff > 0xffff) {
-        panic("Attempted to read from floppy into an invalid memory address!");
+/**
+ * @brief Attempt to read floppy geometry from the FAT BPB in the first sector
+ *
+ * @param storage Storage handle
+ * @param bdata BIOS storage data, sector_size and bounce must be valid
+ * @return int 0 if geometry was found, else < 0
+ */
+static int _floppy_geometry_bpb(storage_hand_t *storage, storage_bios_data_t *bdata) {
+    /* Sector 0 is always C/H/S 0/0/1, regardless of geometry */
+    if(_bios_xfer(bdata, bdata->bounce.buff, 0, 1) < 0) {
+        return -1;
+    }
+
+    fat_geometry_t geom;
+    if(fs_fat_geometry((const fat_bootsector_t *)bdata->bounce.buff, bdata->sector_size, &geom)) {
+        return -1;
     }
 
+    bdata->sectors_per_track = geom.sectors_per_track;
+    bdata->n_heads           = geom.heads;
+    bdata->n_cylinders       = geom.total_sectors / (geom.sectors_per_track * geom.heads);
+    storage->size            = geom.total_sectors * bdata->sector_size;
+
+    return 0;
+}
+
+/**
+ * @brief Attempt to read floppy geometry via INT 13h AH=08h
+ *
+ * @note This reports the geometry of the drive rather than that of the
+ * inserted media, so it is only used when the media does not describe itself.
+ *
+ * @param storage Storage handle
+ * @param bdata BIOS storage data
+ * @return int 0 if geometry was found, else < 0
+ */
+static int _floppy_geometry_bios(storage_hand_t *storage, storage_bios_data_t *bdata) {
     bios_call_t call;
     memset(&call, 0, sizeof(bios_call_t));
 
-    offset /= 512;
+    call.int_n = 0x13;
+    call.ah    = 0x08;
+    call.dl    = bdata->bios_id;
+    _bios_disk_call(bdata, &call);
+
+    if((call.eflags & EFLAGS_CF) ||
+       ((call.cl & 0x3F) == 0)) {
+        return -1;
+    }
+
+    bdata->sectors_per_track = call.cl & 0x3F;
+    bdata->n_heads           = call.dh + 1;
+    bdata->n_cylinders       = (call.ch | ((call.cl & 0xC0) << 2)) + 1;
+    storage->size            = bdata->n_cylinders * bdata->n_heads *
+                               bdata->sectors_per_track * bdata->sector_size;
+
+    return 0;
+}
+
+/**
+ * @brief Determine floppy geometry
+ *
+ * Prefers the FAT BPB of the inserted media, falling back to INT 13h AH=08h,
+ * and finally to a standard 1.44 MB layout.
+ *
+ * @param storage Storage handle
+ * @param bdata BIOS storage data, sector_size and bounce must be valid
+ */
+static void _floppy_geometry(storage_hand_t *storage, storage_bios_data_t *bdata) {
+    /* Standard 1.44 MB layout, also used to read the first sector */
+    bdata->sectors_per_track = 18;
+    bdata->n_heads           = 2;
+    bdata->n_cylinders       = 80;
+    storage->size            = 2880 * 512;
+
+    if(!_floppy_geometry_bpb(storage, bdata)) {
+#if (DEBUG_STORAGE_BIOS)
+        printf("storage_bios: Geometry from BPB:");
+#endif
+    } else if(!_floppy_geometry_bios(storage, bdata)) {
+#if (DEBUG_STORAGE_BIOS)
+        printf("storage_bios: Geometry from BIOS:");
+#endif
+    } else {
+        printf("storage_bios: Could not determine geometry, assuming 1.44 MB\n");
+        return;
+    }
+
+#if (DEBUG_STORAGE_BIOS)
+    printf(" %hu/%hu/%hu\n", bdata->n_cylinders, bdata->n_heads, bdata->sectors_per_track);
+#endif
+}
+
+/**
+ * @brief Make a single attempt at reading a run of sectors from a floppy disk
+ *
+ * @note The run must not cross a track boundry, as the BIOS will not advance
+ * to the next head or cylinder on its own.
+ *
+ * @param bdata BIOS storage data
+ * @param buff Buffer to read into, must be below 1 MiB and not cross a 64 KiB boundary
+ * @param lba First sector to read
+ * @param count Number of sectors to read
+ * @return int 0 on success, else < 0
+ */
+static int _floppy_read_sectors(storage_bios_data_t *bdata, void *buff, uint32_t lba, uint8_t count) {
+    uint32_t start = (uint32_t)buff;
+    uint32_t end   = start + (count * 512) - 1;
+    if((end >= STORAGE_BOUNCE_LIMIT_REALMODE) ||
+       ((start / STORAGE_BOUNCE_BOUNDARY_DMA) != (end / STORAGE_BOUNCE_BOUNDARY_DMA))) {
+        panic("Attempted to read from floppy into an invalid memory address!");
+    }
+
+    bios_call_t call;
+    memset(&call, 0, sizeof(bios_call_t));
 
-    uint16_t track  = offset / bdata->sectors_per_track;
-    uint8_t  sector = (offset % bdata->sectors_per_track) + 1;
+    uint16_t track  = lba / bdata->sectors_per_track;
+    uint8_t  sector = (lba % bdata->sectors_per_track) + 1;
     uint8_t  head   = track % bdata->n_heads;
              track  = track / bdata->n_heads;
 
 #if (DEBUG_STORAGE_BIOS)
-    printf(" [%02hu,%02hhu,%02hhu]", track, head, sector);
+    printf(" [%02hu,%02hhu,%02hhu+%02hhu]", track, head, sector, count);
 #endif
 
-    int attempts = 4;
+    call.int_n = 0x13;
+    call.ah    = 0x02;
+    call.al    = count;
+    call.es    = start >> 4;
+    call.bx    = start & 0x0F;
+    call.cl    = sector;
+    call.ch    = track;
+    call.dl    = bdata->bios_id;
+    call.dh    = head;
+    _bios_disk_call(bdata, &call);
+
+    if(call.eflags & EFLAGS_CF) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Make a single attempt at reading a run of sectors using INT 13h extensions
+ *
+ * @param bdata BIOS storage data
+ * @param buff Buffer to read into, must be below 1 MiB
+ * @param lba First sector to read
+ * @param count Number of sectors to read, at most STORAGE_BIOS_EDD_MAX_SECTORS
+ * @return int 0 on success, else < 0
+ */
+static int _edd_read_sectors(storage_bios_data_t *bdata, void *buff, uint32_t lba, uint8_t count) {
+    if(((uint32_t)buff + (count * bdata->sector_size)) > STORAGE_BOUNCE_LIMIT_REALMODE) {
+        panic("Attempted to read from disk into an invalid memory address!");
+    }
 
-    while(--attempts) {
 #if (DEBUG_STORAGE_BIOS)
-        printf(" TRY");
+    printf(" [%u+%hhu]", lba, count);
 #endif
-        call.int_n = 0x13;
-        call.ax    = 0x0201;
-        call.bx    = (uint16_t)(uintptr_t)buff;
-        call.cl    = sector;
-        call.ch    = track;
-        call.dl    = bdata->bios_id;
-        call.dh    = head;
-        bios_call(&call);
-
-        if(!(call.eflags & EFLAGS_CF)) {
-            /* Read was successful */
+
+    /* The BIOS may update the packet, so it must be rebuilt each attempt */
+    memset(&_edd_dap, 0, sizeof(_edd_dap));
+    _edd_dap.size    = sizeof(_edd_dap);
+    _edd_dap.count   = count;
+    _edd_dap.offset  = (uint32_t)buff & 0x0F;
+    _edd_dap.segment = (uint32_t)buff >> 4;
+    _edd_dap.lba     = lba;
+
+    bios_call_t call;
+    memset(&call, 0, sizeof(bios_call_t));
+    call.int_n = 0x13;
+    call.ah    = 0x42;
+    call.dl    = bdata->bios_id;
+    call.si    = (uint16_t)(uintptr_t)&_edd_dap;
+    _bios_disk_call(bdata, &call);
+
+    if(call.eflags & EFLAGS_CF) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Read as many sectors as possible in a single BIOS call
+ *
+ * The size of each transfer adapts to the reliability of the device. On an
+ * error, the transfer size is halved and the read retried, so that a single
+ * bad sector only slows down the transfers around it. After
+ * STORAGE_BIOS_XFER_GROW clean transfers, the transfer size is doubled again.
+ * The drive is only reset if a retry also fails, as the first error is often
+ * transient (e.g. floppy motor spin-up).
+ *
+ * @param data BIOS storage data
+ * @param buff Buffer to read into, reachable from real mode
+ * @param lba First sector to read
+ * @param count Maximum number of sectors to read
+ * @return Number of sectors read, or < 0 on error
+ */
+static int _bios_xfer(void *data, void *buff, uint32_t lba, uint32_t count) {
+    storage_bios_data_t *bdata = (storage_bios_data_t *)data;
+
+    if(!(bdata->flags & STORAGE_BIOS_FLAG_EDD)) {
+        /* The BIOS cannot read across a track boundry */
+        uint32_t track_left = bdata->sectors_per_track - (lba % bdata->sectors_per_track);
+        if(count > track_left) {
+            count = track_left;
+        }
+    }
+    if(count > bdata->xfer.cur) {
+        count = bdata->xfer.cur;
+    }
+
+    unsigned attempts = 0;
+    unsigned errors   = 0;
+
+    for(;;) {
+        bdata->stats->xfers++;
+
+        int ret;
+        if(bdata->flags & STORAGE_BIOS_FLAG_EDD) {
+            ret = _edd_read_sectors(bdata, buff, lba, count);
+        } else {
+            ret = _floppy_read_sectors(bdata, buff, lba, count);
+        }
+
+        if(!ret) {
             break;
         }
 
-        _floppy_reset(bdata->bios_id);
+        bdata->xfer.clean = 0;
+        errors++;
+
+        if(count > 1) {
+            /* Narrow down on the failing sector, rather than failing the whole run */
+            count /= 2;
+            bdata->xfer.cur = count;
+        } else if(++attempts >= STORAGE_BIOS_ATTEMPTS) {
+            bdata->stats->failures++;
+            status_working(WORKING_STATUS_WORKING);
+            return -1;
+        }
+
+#if (DEBUG_STORAGE_BIOS)
+        printf(" RETRY");
+#endif
+        bdata->stats->retries++;
+        if(errors > 1) {
+            _bios_reset(bdata);
+            bdata->stats->resets++;
+        }
     }
 
     status_working(WORKING_STATUS_WORKING);
+    bdata->stats->read += count * bdata->sector_size;
 
-    if(attempts == 0) {
-        /* Failed to read sector */
-        return -1;
+    if((bdata->xfer.cur < bdata->xfer.max) &&
+       (++bdata->xfer.clean >= STORAGE_BIOS_XFER_GROW)) {
+        bdata->xfer.clean = 0;
+        bdata->xfer.cur   = ((bdata->xfer.cur * 2) > bdata->xfer.max) ?
+                            bdata->xfer.max : (bdata->xfer.cur * 2);
     }
 
+    return (int)count;
+}
+
+#ifdef CONFIG_STORAGE_BIOS_TRACKCACHE
+static void _tcache_init(storage_bios_data_t *bdata) {
+    for(unsigned i = 0; i < CONFIG_STORAGE_BIOS_TRACKCACHE_CNT; i++) {
+        /* Track buffers are read into directly, so must be DMA-safe */
+        bdata->tcache.buff[i]  = storage_bounce_alloc(bdata->sectors_per_track * bdata->sector_size,
+                                                      STORAGE_BOUNCE_BOUNDARY_DMA);
+        bdata->tcache.track[i] = STORAGE_BIOS_TRACK_NONE;
+        bdata->tcache.rank[i]  = i;
+    }
+}
+
+/**
+ * @brief Touch track cache entry, setting its rank to zero
+ *
+ * @param bdata BIOS storage data
+ * @param idx Cache entry to touch
+ */
+static void _tcache_touch(storage_bios_data_t *bdata, unsigned idx) {
+    for(unsigned i = 0; i < CONFIG_STORAGE_BIOS_TRACKCACHE_CNT; i++) {
+        if(i == idx) {
+            continue;
+        }
+        if(bdata->tcache.rank[i] < bdata->tcache.rank[idx]) {
+            bdata->tcache.rank[i]++;
+        }
+    }
+    bdata->tcache.rank[idx] = 0;
+}
+
+/**
+ * @brief Get track from the cache, reading it into the oldest entry if not present
+ *
+ * @param bdata BIOS storage data
+ * @param track Track to retrieve, counting both heads
+ * @return Pointer to track data, or NULL on read error
+ */
+static void *_tcache_get(storage_bios_data_t *bdata, uint32_t track) {
+    unsigned entry = 0;
+
+    for(unsigned i = 0; i < CONFIG_STORAGE_BIOS_TRACKCACHE_CNT; i++) {
+        if(bdata->tcache.track[i] == track) {
+            bdata->stats->track_hits++;
+            _tcache_touch(bdata, i);
+            return bdata->tcache.buff[i];
+        }
+        /* Find highest-rank (oldest) cache entry */
+        if(bdata->tcache.rank[i] > bdata->tcache.rank[entry]) {
+            entry = i;
+        }
+    }
+
+    bdata->stats->track_misses++;
+
+    /* Invalidate first, in case the read fails part way through */
+    bdata->tcache.track[entry] = STORAGE_BIOS_TRACK_NONE;
+    for(uint32_t done = 0; done < bdata->sectors_per_track;) {
+        int ret = _bios_xfer(bdata, bdata->tcache.buff[entry] + (done * bdata->sector_size),
+                             (track * bdata->sectors_per_track) + done,
+                             bdata->sectors_per_track - done);
+        if(ret < 0) {
+            return NULL;
+        }
+        done += ret;
+    }
+    bdata->tcache.track[entry] = track;
+    _tcache_touch(bdata, entry);
+
+    return bdata->tcache.buff[entry];
+}
+
+/**
+ * @brief Read sectors from floppy by way of the track cache
+ *
+ * @param bdata BIOS storage data
+ * @param buff Buffer to read into, may be at any address
+ * @param lba First sector to read
+ * @param count Number of sectors to read
+ * @return int 0 on success, else < 0
+ */
+static int _tcache_read(storage_bios_data_t *bdata, void *buff, uint32_t lba, uint32_t count) {
+    while(count) {
+        uint32_t track  = lba / bdata->sectors_per_track;
+        uint32_t sector = lba % bdata->sectors_per_track;
+        uint32_t run    = bdata->sectors_per_track - sector;
+        if(run > count) {
+            run = count;
+        }
+
+        void *tdata = _tcache_get(bdata, track);
+        if(tdata == NULL) {
+            return -1;
+        }
+        memcpy(buff, tdata + (sector * bdata->sector_size), run * bdata->sector_size);
+
+        buff  += run * bdata->sector_size;
+        lba   += run;
+        count -= run;
+    }
+
+#if (DEBUG_STORAGE_BIOS)
+    printf(" [TC: %u/%u]", bdata->stats->track_hits, bdata->stats->track_misses);
+#endif
+
     return 0;
 }
+#endif /* CONFIG_STORAGE_BIOS_TRACKCACHE */
 
 static ssize_t _read(storage_hand_t *storage, void *buff, off_t offset, size_t size) {
 #if (DEBUG_STORAGE_BIOS)
     printf("_bios_read(..., %p, %5d, %4d)", buff, offset, size);
 #endif
 
-    if((offset % 512) || (size % 512)) {
+    storage_bios_data_t *bdata = (storage_bios_data_t *)storage->data;
+
+    if((offset % bdata->sector_size) || (size % bdata->sector_size)) {
         /* Currently only support sector-aligned reads */
         panic("Address or size not aligned to sector count!");
     }
@@ -110,23 +571,27 @@ static ssize_t _read(storage_hand_t *storage, void *buff, off_t offset, size_t s
         panic("Negative offset!");
     }
 
-    storage_bios_data_t *bdata = (storage_bios_data_t *)storage->data;
+    uint32_t lba   = offset / bdata->sector_size;
+    uint32_t count = size   / bdata->sector_size;
+    int      ret;
 
-    size_t pos = 0;
+#ifdef CONFIG_STORAGE_BIOS_TRACKCACHE
+    if(!(bdata->flags & STORAGE_BIOS_FLAG_EDD)) {
+        /* Data is always copied out of the track cache, so the bounce engine
+         * is not needed here. */
+        ret = _tcache_read(bdata, buff, lba, count);
+    } else {
+        ret = storage_bounce_read(&bdata->bounce, buff, lba, count);
+    }
+#else
+    ret = storage_bounce_read(&bdata->bounce, buff, lba, count);
+#endif
 
-    if(bdata->bios_id < 0x80) {
-        /* Floppy */
-        while (pos < size) {
-            if(_floppy_read_sector(bdata, buff + pos, offset + pos)) {
+    if(ret) {
 #if (DEBUG_STORAGE_BIOS)
-                printf(" FAIL\n");
+        printf(" FAIL [retries: %u, resets: %u, failures: %u]\n",
+               bdata->stats->retries, bdata->stats->resets, bdata->stats->failures);
 #endif
-                return -1;
-            }
-            pos += 512;
-        }
-    } else {
-        /* @todo Hard disk */
         return -1;
     }
 
@@ -142,6 +607,5 @@ static ssize_t _read(storage_hand_t *storage, void *buff, off_t offset, size_t s
     printf(" OK\n");
 #endif
 
-    return (ssize_t)pos;
+    return (ssize_t)size;
 }
-
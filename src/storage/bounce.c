@@ -0,0 +1,104 @@
+#include <string.h>
+
+#include "io/output.h"
+#include "mm/alloc.h"
+#include "storage/bounce.h"
+
+void *storage_bounce_alloc(size_t size, uintptr_t boundary) {
+    /* Aligning to the next power of two guarantees the region will not cross
+     * any larger power of two boundary. */
+    unsigned align = 2;
+    while((1UL << align) < size) {
+        align++;
+    }
+
+    void *buff = alloc(size, ALLOC_FLAG_ALIGN(align));
+
+    if(boundary &&
+       (((uintptr_t)buff / boundary) != (((uintptr_t)buff + size - 1) / boundary))) {
+        panic("storage_bounce_alloc: Could not allocate %u bytes within %x boundary", size, boundary);
+    }
+
+    return buff;
+}
+
+int storage_bounce_init(storage_bounce_t *bounce, size_t size, uintptr_t limit, uintptr_t boundary, uint16_t block_size) {
+    if((size < block_size) || !block_size) {
+        return -1;
+    }
+
+    bounce->size       = size - (size % block_size);
+    bounce->buff       = storage_bounce_alloc(bounce->size, boundary);
+    bounce->limit      = limit;
+    bounce->boundary   = boundary;
+    bounce->block_size = block_size;
+
+    return 0;
+}
+
+/**
+ * @brief Determine how many blocks can be transferred directly into the
+ * destination
+ *
+ * @param bounce Bounce engine
+ * @param dest Destination address
+ * @param count Number of blocks desired
+ * @return Number of blocks that can be transferred directly, may be 0
+ */
+static uint32_t _bounce_direct_blocks(const storage_bounce_t *bounce, uintptr_t dest, uint32_t count) {
+    if(dest >= bounce->limit) {
+        return 0;
+    }
+
+    uintptr_t end = dest + (count * bounce->block_size);
+    if(end > bounce->limit) {
+        end = bounce->limit;
+    }
+
+    if(bounce->boundary) {
+        uintptr_t next = (dest - (dest % bounce->boundary)) + bounce->boundary;
+        if(end > next) {
+            end = next;
+        }
+    }
+
+    return (end - dest) / bounce->block_size;
+}
+
+uint32_t storage_bounce_plan(const storage_bounce_t *bounce, void *dest, uint32_t count, void **xbuff) {
+    uint32_t blocks = _bounce_direct_blocks(bounce, (uintptr_t)dest, count);
+    if(blocks) {
+        *xbuff = dest;
+        return blocks;
+    }
+
+    /* Destination is not reachable, stage as much as possible in the bounce
+     * region. */
+    *xbuff = bounce->buff;
+    blocks = bounce->size / bounce->block_size;
+
+    return (blocks > count) ? count : blocks;
+}
+
+int storage_bounce_read(storage_bounce_t *bounce, void *buff, uint32_t block, uint32_t count) {
+    uint32_t done = 0;
+
+    while(done < count) {
+        void    *dest = buff + (done * bounce->block_size);
+        void    *xbuff;
+        uint32_t blocks = storage_bounce_plan(bounce, dest, count - done, &xbuff);
+
+        int ret = bounce->xfer(bounce->data, xbuff, block + done, blocks);
+        if(ret <= 0) {
+            return -1;
+        }
+
+        if(xbuff != dest) {
+            memcpy(dest, xbuff, ret * bounce->block_size);
+        }
+
+        done += ret;
+    }
+
+    return 0;
+}
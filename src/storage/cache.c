@@ -0,0 +1,97 @@
+#include <stddef.h>
+
+#include "mm/alloc.h"
+#include "storage/cache.h"
+
+storage_cache_t *storage_cache_create(storage_hand_t *storage, size_t block_size) {
+    storage_cache_t *cache = (storage_cache_t *)alloc(sizeof(storage_cache_t), 0);
+    void            *buff  = alloc(block_size * CONFIG_STORAGE_CACHE_CNT, 0);
+
+    cache->storage    = storage;
+    cache->block_size = block_size;
+    cache->clock      = 0;
+
+    for(unsigned i = 0; i < CONFIG_STORAGE_CACHE_CNT; i++) {
+        cache->ents[i].offset = -1;
+        cache->ents[i].buff   = buff + (i * block_size);
+        cache->ents[i].next   = NULL;
+    }
+    for(unsigned i = 0; i < STORAGE_CACHE_HASH_CNT; i++) {
+        cache->hash[i] = NULL;
+    }
+
+    return cache;
+}
+
+/**
+ * @brief Get the hash bucket a block belongs in
+ *
+ * @param cache Block cache
+ * @param offset Offset of block into storage device
+ * @return storage_cache_ent_t** Head of hash bucket
+ */
+static storage_cache_ent_t **_cache_bucket(storage_cache_t *cache, off_t offset) {
+    return &cache->hash[(offset / cache->block_size) & (STORAGE_CACHE_HASH_CNT - 1)];
+}
+
+/**
+ * @brief Choose the entry to replace: an unused entry if there is one, else
+ * the least recently used
+ *
+ * @param cache Block cache
+ * @return storage_cache_ent_t* Entry to replace
+ */
+static storage_cache_ent_t *_cache_victim(storage_cache_t *cache) {
+    storage_cache_ent_t *victim = &cache->ents[0];
+
+    for(unsigned i = 0; i < CONFIG_STORAGE_CACHE_CNT; i++) {
+        storage_cache_ent_t *ent = &cache->ents[i];
+        if(ent->offset < 0) {
+            return ent;
+        }
+        /* Wrapping difference, so this holds across clock overflow */
+        if((int32_t)(ent->used - victim->used) < 0) {
+            victim = ent;
+        }
+    }
+
+    return victim;
+}
+
+const void *storage_cache_get(storage_cache_t *cache, off_t offset) {
+    storage_cache_ent_t **bucket = _cache_bucket(cache, offset);
+
+    cache->clock++;
+
+    for(storage_cache_ent_t *ent = *bucket; ent; ent = ent->next) {
+        if(ent->offset == offset) {
+            cache->storage->stats.cache_hits++;
+            ent->used = cache->clock;
+            return ent->buff;
+        }
+    }
+
+    cache->storage->stats.cache_misses++;
+
+    storage_cache_ent_t *ent = _cache_victim(cache);
+    if(ent->offset >= 0) {
+        /* Unlink from its current hash bucket */
+        storage_cache_ent_t **link = _cache_bucket(cache, ent->offset);
+        while(*link != ent) {
+            link = &(*link)->next;
+        }
+        *link = ent->next;
+    }
+
+    ent->offset = -1;
+    if(storage_read(cache->storage, ent->buff, offset, cache->block_size) != (ssize_t)cache->block_size) {
+        return NULL;
+    }
+
+    ent->offset = offset;
+    ent->used   = cache->clock;
+    ent->next   = *bucket;
+    *bucket     = ent;
+
+    return ent->buff;
+}
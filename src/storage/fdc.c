@@ -0,0 +1,597 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "intr/interrupts.h"
+#include "io/dma.h"
+#include "io/ioport.h"
+#include "io/output.h"
+#include "storage/fdc.h"
+#include "storage/fs/fat.h"
+#include "time/time.h"
+
+/* @note since we currently allow only a single device open at a time, having
+ * this statically declared should be fine. */
+static storage_fdc_data_t _fdc_data = { 0 };
+
+#define FDC_TIMEOUT_CMD  (100)  /**< Timeout for a single FIFO byte, in ms */
+#define FDC_TIMEOUT_IRQ  (2000) /**< Timeout for a command to complete, in ms */
+#define FDC_MOTOR_SPINUP (300)  /**< Motor spin-up time, in ms */
+
+static ssize_t _read(storage_hand_t *storage, void *buff, off_t offset, size_t size);
+static int     _submit(storage_hand_t *storage, storage_req_t *req);
+static void    _poll(storage_hand_t *storage);
+static void    _fdc_int_handler(uint8_t int_id, uint32_t errno, void *data);
+static int     _fdc_reset(storage_fdc_data_t *fdata);
+static int     _fdc_recalibrate(storage_fdc_data_t *fdata);
+static int     _fdc_geometry(storage_hand_t *storage, storage_fdc_data_t *fdata);
+
+int storage_fdc_init(storage_hand_t *storage, uint8_t drive) {
+    if(drive > FDC_DOR_SEL__MSK) {
+        return -1;
+    }
+
+    memset(storage, 0, sizeof(storage_hand_t));
+    memset(&_fdc_data, 0, sizeof(_fdc_data));
+    _fdc_data.stats = &storage->stats;
+
+    _fdc_data.drive       = drive;
+    _fdc_data.cylinder    = FDC_CYLINDER_UNKNOWN;
+    _fdc_data.sector_size = 512;
+
+    interrupt_register(INT_ID_FLOPPY, _fdc_int_handler, &_fdc_data);
+    interrupt_enable(INT_ID_FLOPPY);
+
+    /* The motor is turned on by the reset, and is left running for as long as
+     * the bootloader is active */
+    if(_fdc_reset(&_fdc_data)) {
+        printf("storage_fdc: Controller did not respond to reset\n");
+        goto fdc_init_fail;
+    }
+
+    if(storage_bounce_init(&_fdc_data.bounce, STORAGE_FDC_BOUNCE_SIZE,
+                           DMA_LIMIT, DMA_BOUNDARY, _fdc_data.sector_size)) {
+        goto fdc_init_fail;
+    }
+
+    if(_fdc_recalibrate(&_fdc_data) ||
+       _fdc_geometry(storage, &_fdc_data)) {
+        printf("storage_fdc: Could not access media in drive %hhu\n", drive);
+        goto fdc_init_fail;
+    }
+
+#if (DEBUG_STORAGE_FDC)
+    printf("storage_fdc: Drive %hhu, rate %hhu, geometry %hu/%hu/%hu\n", drive, _fdc_data.rate,
+           _fdc_data.n_cylinders, _fdc_data.n_heads, _fdc_data.sectors_per_track);
+#endif
+
+    storage->block_size = _fdc_data.sector_size;
+    storage->data       = &_fdc_data;
+    storage->read       = _read;
+    storage->submit     = _submit;
+    storage->poll       = _poll;
+
+    return 0;
+
+fdc_init_fail:
+    /* Stop the motor, and stop listening for the controller */
+    outb(FDC_REG_DOR, FDC_DOR_NRESET | FDC_DOR_IRQDMA | drive);
+    interrupt_disable(INT_ID_FLOPPY);
+    return -1;
+}
+
+static void _fdc_int_handler(uint8_t int_id, uint32_t errno, void *data) {
+    (void)int_id;
+    (void)errno;
+    ((storage_fdc_data_t *)data)->irq = 1;
+}
+
+/**
+ * @brief Wait for the controller to raise IRQ 6
+ *
+ * @param fdata FDC storage data
+ * @return int 0 on success, < 0 on timeout
+ */
+static int _fdc_wait_irq(storage_fdc_data_t *fdata) {
+    time_ticks_t timeout;
+    time_offset(&timeout, FDC_TIMEOUT_IRQ);
+
+    while(!fdata->irq) {
+        if(time_ispast(&timeout)) {
+            return -1;
+        }
+        asm volatile("hlt");
+    }
+    fdata->irq = 0;
+
+    return 0;
+}
+
+/**
+ * @brief Write a byte to the controller FIFO
+ *
+ * @param val Byte to write
+ * @return int 0 on success, < 0 on timeout
+ */
+static int _fdc_write(uint8_t val) {
+    time_ticks_t timeout;
+    time_offset(&timeout, FDC_TIMEOUT_CMD);
+
+    while((inb(FDC_REG_MSR) & (FDC_MSR_RQM | FDC_MSR_DIO)) != FDC_MSR_RQM) {
+        if(time_ispast(&timeout)) {
+            return -1;
+        }
+    }
+    outb(FDC_REG_FIFO, val);
+
+    return 0;
+}
+
+/**
+ * @brief Read a byte from the controller FIFO
+ *
+ * @return int Byte read, or < 0 on timeout
+ */
+static int _fdc_read(void) {
+    time_ticks_t timeout;
+    time_offset(&timeout, FDC_TIMEOUT_CMD);
+
+    while((inb(FDC_REG_MSR) & (FDC_MSR_RQM | FDC_MSR_DIO)) != (FDC_MSR_RQM | FDC_MSR_DIO)) {
+        if(time_ispast(&timeout)) {
+            return -1;
+        }
+    }
+
+    return inb(FDC_REG_FIFO);
+}
+
+/**
+ * @brief Send a command to the controller
+ *
+ * @param cmd Command bytes
+ * @param len Number of command bytes
+ * @return int 0 on success, < 0 on timeout
+ */
+static int _fdc_command(const uint8_t *cmd, size_t len) {
+    for(size_t i = 0; i < len; i++) {
+        if(_fdc_write(cmd[i])) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Acknowledge an interrupt from a seek, recalibrate or reset
+ *
+ * @param st0 Where to store ST0
+ * @param cyl Where to store the present cylinder
+ * @return int 0 on success, < 0 on timeout
+ */
+static int _fdc_sense_interrupt(uint8_t *st0, uint8_t *cyl) {
+    if(_fdc_write(FDC_CMD_SENSEINT)) {
+        return -1;
+    }
+
+    int ret = _fdc_read();
+    if(ret < 0) {
+        return -1;
+    }
+    *st0 = (uint8_t)ret;
+
+    if((ret = _fdc_read()) < 0) {
+        return -1;
+    }
+    *cyl = (uint8_t)ret;
+
+    return 0;
+}
+
+/**
+ * @brief Reset the controller, and program data rate and drive timings
+ *
+ * The drive motor is kept on across the reset, and is given time to reach
+ * speed before returning.
+ *
+ * @param fdata FDC storage data
+ * @return int 0 on success, < 0 on error
+ */
+static int _fdc_reset(storage_fdc_data_t *fdata) {
+    uint8_t st0, cyl;
+
+    fdata->irq = 0;
+    outb(FDC_REG_DOR, FDC_DOR_MOTOR(fdata->drive) | fdata->drive);
+    outb(FDC_REG_DOR, FDC_DOR_NRESET | FDC_DOR_IRQDMA | FDC_DOR_MOTOR(fdata->drive) | fdata->drive);
+    if(_fdc_wait_irq(fdata)) {
+        return -1;
+    }
+
+    /* After a reset, an interrupt status must be collected for each drive */
+    for(unsigned i = 0; i < 4; i++) {
+        if(_fdc_sense_interrupt(&st0, &cyl)) {
+            return -1;
+        }
+    }
+
+    outb(FDC_REG_CCR, fdata->rate);
+
+    /* SRT = 8 ms, HUT = 240 ms, HLT = 16 ms, DMA mode */
+    const uint8_t specify[3] = { FDC_CMD_SPECIFY, 0x8F, 0x10 };
+    if(_fdc_command(specify, sizeof(specify))) {
+        return -1;
+    }
+
+    fdata->cylinder = FDC_CYLINDER_UNKNOWN;
+
+    time_delay(FDC_MOTOR_SPINUP);
+
+    return 0;
+}
+
+/**
+ * @brief Move the heads to cylinder 0
+ *
+ * @param fdata FDC storage data
+ * @return int 0 on success, < 0 on error
+ */
+static int _fdc_recalibrate(storage_fdc_data_t *fdata) {
+    /* Older controllers step at most 77 times per recalibrate, which is not
+     * enough for 80-cylinder media, so a second attempt may be required. */
+    for(unsigned i = 0; i < 2; i++) {
+        uint8_t st0, cyl;
+        const uint8_t cmd[2] = { FDC_CMD_RECALIBRATE, fdata->drive };
+
+        fdata->irq = 0;
+        if(_fdc_command(cmd, sizeof(cmd)) ||
+           _fdc_wait_irq(fdata) ||
+           _fdc_sense_interrupt(&st0, &cyl)) {
+            return -1;
+        }
+
+        if(!(st0 & FDC_ST0_IC__MSK) && (cyl == 0)) {
+            fdata->cylinder = 0;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Move the heads to the given cylinder
+ *
+ * @param fdata FDC storage data
+ * @param head Head to select
+ * @param cylinder Cylinder to seek to
+ * @return int 0 on success, < 0 on error
+ */
+static int _fdc_seek(storage_fdc_data_t *fdata, uint8_t head, uint8_t cylinder) {
+    if(fdata->cylinder == cylinder) {
+        return 0;
+    }
+
+    uint8_t st0, cyl;
+    const uint8_t cmd[3] = { FDC_CMD_SEEK, (head << 2) | fdata->drive, cylinder };
+
+    fdata->irq = 0;
+    if(_fdc_command(cmd, sizeof(cmd)) ||
+       _fdc_wait_irq(fdata) ||
+       _fdc_sense_interrupt(&st0, &cyl)) {
+        fdata->cylinder = FDC_CYLINDER_UNKNOWN;
+        return -1;
+    }
+
+    if((st0 & FDC_ST0_IC__MSK) || (cyl != cylinder)) {
+        fdata->cylinder = FDC_CYLINDER_UNKNOWN;
+        return -1;
+    }
+
+    fdata->cylinder = cylinder;
+
+    return 0;
+}
+
+/**
+ * @brief Seek to the start of a run of sectors, and start reading it
+ *
+ * @note With the multi-track flag set, the run may continue from head 0 onto
+ * head 1, but must not cross a cylinder boundry.
+ *
+ * @param fdata FDC storage data
+ * @param buff Buffer to read into, must be below 16 MiB and not cross a 64 KiB boundary
+ * @param lba First sector to read
+ * @param count Number of sectors to read
+ * @return int 0 if the read was started, else < 0
+ */
+static int _fdc_read_start(storage_fdc_data_t *fdata, void *buff, uint32_t lba, uint32_t count) {
+    uint16_t track  = lba / fdata->sectors_per_track;
+    uint8_t  sector = (lba % fdata->sectors_per_track) + 1;
+    uint8_t  head   = track % fdata->n_heads;
+    uint8_t  cyl    = track / fdata->n_heads;
+
+#if (DEBUG_STORAGE_FDC)
+    printf(" [%02hhu,%02hhu,%02hhu+%02u]", cyl, head, sector, count);
+#endif
+
+    if(_fdc_seek(fdata, head, cyl)) {
+        return -1;
+    }
+
+    if(dma_setup(STORAGE_FDC_DMA_CHANNEL, buff, count * fdata->sector_size,
+                 DMA_MODE_SINGLE | DMA_MODE_XFER_WRITE)) {
+        panic("Attempted to read from floppy into an invalid memory address!");
+    }
+
+    /* The transfer is ended by the DMA terminal count, so EOT is always the
+     * last sector of the track. */
+    const uint8_t cmd[9] = {
+        FDC_CMD_READ | FDC_CMD_FLAG_MT | FDC_CMD_FLAG_MFM | FDC_CMD_FLAG_SK,
+        (head << 2) | fdata->drive,
+        cyl,
+        head,
+        sector,
+        FDC_SECTOR_SIZE_512,
+        fdata->sectors_per_track,
+        FDC_GAP3_LENGTH,
+        0xFF
+    };
+
+    fdata->stats->xfers++;
+    fdata->stats->read += count * fdata->sector_size;
+
+    fdata->irq = 0;
+    return _fdc_command(cmd, sizeof(cmd));
+}
+
+/**
+ * @brief Collect the result of a read, once the controller has raised IRQ 6
+ *
+ * @return int 0 if the read succeeded, else < 0
+ */
+static int _fdc_read_result(void) {
+    /* ST0, ST1, ST2, C, H, R, N */
+    uint8_t result[7];
+    for(unsigned i = 0; i < sizeof(result); i++) {
+        int ret = _fdc_read();
+        if(ret < 0) {
+            return -1;
+        }
+        result[i] = (uint8_t)ret;
+    }
+
+    if(result[0] & FDC_ST0_IC__MSK) {
+#if (DEBUG_STORAGE_FDC)
+        printf(" [ST: %02hhx %02hhx %02hhx]", result[0], result[1], result[2]);
+#endif
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Make a single attempt at reading a run of sectors, waiting for it to
+ * complete
+ *
+ * @param fdata FDC storage data
+ * @param buff Buffer to read into, see _fdc_read_start()
+ * @param lba First sector to read
+ * @param count Number of sectors to read
+ * @return int 0 on success, else < 0
+ */
+static int _fdc_read_sectors(storage_fdc_data_t *fdata, void *buff, uint32_t lba, uint32_t count) {
+    if(_fdc_read_start(fdata, buff, lba, count) ||
+       _fdc_wait_irq(fdata)) {
+        return -1;
+    }
+
+    return _fdc_read_result();
+}
+
+/**
+ * @brief Record a failed attempt at the command in flight, failing the first
+ * queued request once out of attempts
+ *
+ * @param fdata FDC storage data
+ */
+static void _fdc_error(storage_fdc_data_t *fdata) {
+    fdata->count = 0;
+
+    if(++fdata->attempt < STORAGE_FDC_ATTEMPTS) {
+#if (DEBUG_STORAGE_FDC)
+        printf(" RETRY");
+#endif
+        fdata->stats->retries++;
+        return;
+    }
+
+    storage_req_t *req = fdata->queue;
+    fdata->queue   = req->next;
+    fdata->done    = 0;
+    fdata->attempt = 0;
+    fdata->stats->failures++;
+    status_working(WORKING_STATUS_WORKING);
+
+    storage_req_complete(req, -1);
+}
+
+/**
+ * @brief Start the next command for the first queued request, completing
+ * requests as they are fully transferred
+ *
+ * @param fdata FDC storage data, with no command in flight
+ */
+static void _fdc_next(storage_fdc_data_t *fdata) {
+    storage_req_t *req;
+    while((req = fdata->queue)) {
+        uint32_t left = (req->size / fdata->sector_size) - fdata->done;
+        if(!left) {
+            fdata->queue = req->next;
+            fdata->done  = 0;
+            storage_req_complete(req, (ssize_t)req->size);
+            continue;
+        }
+
+        /* The first failure is retried as-is, as it is often transient */
+        if(fdata->attempt > 1) {
+            fdata->stats->resets++;
+            if(_fdc_reset(fdata) || _fdc_recalibrate(fdata)) {
+                _fdc_error(fdata);
+                continue;
+            }
+        }
+
+        uint32_t lba   = (req->offset / fdata->sector_size) + fdata->done;
+        uint32_t count = storage_bounce_plan(&fdata->bounce, req->buff + (fdata->done * fdata->sector_size),
+                                             left, &fdata->xbuff);
+
+        /* Multi-track reads may continue up to the end of the cylinder */
+        uint32_t cyl_sectors = fdata->sectors_per_track * fdata->n_heads;
+        uint32_t cyl_left    = cyl_sectors - (lba % cyl_sectors);
+        if(count > cyl_left) {
+            count = cyl_left;
+        }
+
+        if(_fdc_read_start(fdata, fdata->xbuff, lba, count)) {
+            _fdc_error(fdata);
+            continue;
+        }
+
+        fdata->count = count;
+        time_offset(&fdata->timeout, FDC_TIMEOUT_IRQ);
+        return;
+    }
+}
+
+/**
+ * @brief Determine data rate and geometry of the inserted media
+ *
+ * Each data rate is tried in turn until the first sector can be read, the
+ * geometry is then taken from the FAT BPB if present, or else assumed from
+ * the data rate.
+ *
+ * @param storage Storage handle
+ * @param fdata FDC storage data
+ * @return int 0 on success, < 0 if the media could not be read
+ */
+static int _fdc_geometry(storage_hand_t *storage, storage_fdc_data_t *fdata) {
+    static const struct {
+        uint8_t  rate;
+        uint8_t  sectors_per_track;
+        uint8_t  n_cylinders;
+    } _rates[] = {
+        { FDC_CCR_RATE_500K, 18, 80 },
+        { FDC_CCR_RATE_1M,   36, 80 },
+        { FDC_CCR_RATE_250K,  9, 80 },
+        { FDC_CCR_RATE_300K,  9, 40 }
+    };
+
+    for(unsigned i = 0; i < (sizeof(_rates) / sizeof(_rates[0])); i++) {
+        fdata->rate              = _rates[i].rate;
+        fdata->sectors_per_track = _rates[i].sectors_per_track;
+        fdata->n_cylinders       = _rates[i].n_cylinders;
+        fdata->n_heads           = 2;
+        outb(FDC_REG_CCR, fdata->rate);
+
+        /* Sector 0 is always C/H/S 0/0/1, regardless of geometry */
+        if(_fdc_read_sectors(fdata, fdata->bounce.buff, 0, 1)) {
+            /* A failed read may leave the controller mid-command, so it is
+             * brought back to a known state before trying the next rate */
+            fdata->stats->resets++;
+            if(_fdc_reset(fdata) || _fdc_recalibrate(fdata)) {
+                return -1;
+            }
+            continue;
+        }
+
+        fat_geometry_t geom;
+        if(!fs_fat_geometry((const fat_bootsector_t *)fdata->bounce.buff, fdata->sector_size, &geom)) {
+            fdata->sectors_per_track = geom.sectors_per_track;
+            fdata->n_heads           = geom.heads;
+            fdata->n_cylinders       = geom.total_sectors / (geom.sectors_per_track * geom.heads);
+        }
+
+        storage->size = fdata->n_cylinders * fdata->n_heads *
+                        fdata->sectors_per_track * fdata->sector_size;
+
+        return 0;
+    }
+
+    return -1;
+}
+
+/**
+ * @note Seeks, and recovery after an error, are waited on here. The data
+ * transfer itself, which makes up most of the time spent, proceeds in the
+ * background using DMA.
+ */
+static void _poll(storage_hand_t *storage) {
+    storage_fdc_data_t *fdata = (storage_fdc_data_t *)storage->data;
+
+    if(fdata->count) {
+        if(fdata->irq) {
+            fdata->irq = 0;
+            if(_fdc_read_result()) {
+                _fdc_error(fdata);
+            } else {
+                void *dest = fdata->queue->buff + (fdata->done * fdata->sector_size);
+                if(fdata->xbuff != dest) {
+                    memcpy(dest, fdata->xbuff, fdata->count * fdata->sector_size);
+                }
+                fdata->done   += fdata->count;
+                fdata->count   = 0;
+                fdata->attempt = 0;
+                status_working(WORKING_STATUS_WORKING);
+            }
+        } else if(time_ispast(&fdata->timeout)) {
+            _fdc_error(fdata);
+        } else {
+            /* Command still in progress */
+            return;
+        }
+    }
+
+    _fdc_next(fdata);
+}
+
+static int _submit(storage_hand_t *storage, storage_req_t *req) {
+    storage_fdc_data_t *fdata = (storage_fdc_data_t *)storage->data;
+
+    if((req->offset % fdata->sector_size) || (req->size % fdata->sector_size)) {
+        /* Currently only support sector-aligned reads */
+        panic("Address or size not aligned to sector count!");
+    }
+    if(req->offset < 0) {
+        panic("Negative offset!");
+    }
+
+    storage_req_t **tail = &fdata->queue;
+    while(*tail) {
+        tail = &(*tail)->next;
+    }
+    *tail = req;
+
+    _poll(storage);
+
+    return 0;
+}
+
+static ssize_t _read(storage_hand_t *storage, void *buff, off_t offset, size_t size) {
+#if (DEBUG_STORAGE_FDC)
+    printf("_fdc_read(..., %p, %5d, %4d)", buff, offset, size);
+#endif
+
+    ssize_t ret = storage_read_wait(storage, buff, offset, size);
+
+#if (DEBUG_STORAGE_FDC)
+    storage_fdc_data_t *fdata = (storage_fdc_data_t *)storage->data;
+    if(ret < 0) {
+        printf(" FAIL [retries: %u, resets: %u, failures: %u]\n",
+               fdata->stats->retries, fdata->stats->resets, fdata->stats->failures);
+    } else {
+        printf(" OK\n");
+    }
+#endif
+
+    return ret;
+}
@@ -38,6 +38,22 @@ int file_open(file_hand_t *file, const char *path) {
     return 0;
 }
 
+ssize_t file_readv(const file_hand_t *file, const storage_seg_t *segs, unsigned n_segs) {
+    if(file->readv) {
+        return file->readv(file, segs, n_segs);
+    }
+
+    ssize_t total = 0;
+    for(unsigned i = 0; i < n_segs; i++) {
+        if(file->read(file, segs[i].buff, segs[i].size, segs[i].offset) != (ssize_t)segs[i].size) {
+            return -1;
+        }
+        total += segs[i].size;
+    }
+
+    return total;
+}
+
 void file_set_default_fs(fs_hand_t *fs) {
     _default_fs = fs;
 }
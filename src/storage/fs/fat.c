@@ -5,11 +5,23 @@
 #include "mm/alloc.h"
 #include "storage/fs/fat.h"
 
+/**
+ * @brief Run of clusters that are contiguous both within a file and on disk
+ */
 typedef struct {
-    off_t first_cluster; /**< Offset into filesystem to first data cluster, in bytes */
+    uint32_t index;  /**< Index within the file of the first cluster of the run */
+    uint32_t length; /**< Number of clusters in the run */
+    off_t    offset; /**< Offset into filesystem of the first cluster of the run, in bytes */
+} fat_extent_t;
+
+typedef struct {
+    fat_extent_t *extents;   /**< Extents making up the file, in file order */
+    unsigned      n_extents; /**< Number of extents, 0 for an empty file */
+    unsigned      cursor;    /**< Extent the last read ended in, where the search for the next read starts */
 } fat_file_data_t;
 
 typedef struct {
+    uint8_t  type;         /**< FAT type, 12 or 16, determined by the number of clusters */
     uint16_t sector_size;  /**< Number of bytes per sector */
     uint16_t cluster_size; /**< Size of cluster, in bytes */
     off_t    fat_offset;   /**< Offset into filesystem of first FAT */
@@ -19,20 +31,24 @@ typedef struct {
     off_t    rootdir_first_cluster; /**< Offset into filesystem of first cluster of root directory, in bytes */
     size_t   rootdir_size;          /**< Size of root directory in bytes */
 
-    file_hand_t     rootdir;       /**< File representing root directory - internal use only*/
-    fat_file_data_t _rootdir_data; /**< Data for rootdir file, preventing an extra allocation - internal use only */
+    uint16_t *fat;         /**< Decoded FAT, indexed by cluster number */
+    uint32_t  fat_entries; /**< Number of entries in fat */
 
-#define FAT_CACHE_CNT (4) /**< Number of FAT clusters to cache */
-    struct {
-        off_t   clust[FAT_CACHE_CNT]; /**< Offset of cached clusters into FS */
-        uint8_t rank[FAT_CACHE_CNT];  /**< Rank of cache entry, representing which was last used */
-        void   *buf;                  /**< Buffer of cluster caches */
-    } cache;
+    file_hand_t     rootdir;         /**< File representing root directory - internal use only*/
+    fat_file_data_t _rootdir_data;   /**< Data for rootdir file, preventing an extra allocation - internal use only */
+    fat_extent_t    _rootdir_extent; /**< The root directory's single extent - internal use only */
 } fat_data_t;
 
+#define FAT_LOCAL_READS (8) /**< Device reads per file read that need no allocation */
+
 static ssize_t _fat_file_read(const file_hand_t *file, void *buf, size_t sz, off_t off);
+static ssize_t _fat_file_readv(const file_hand_t *file, const storage_seg_t *segs, unsigned n_segs);
 static int     _fat_fs_find(fs_hand_t *fs, const file_hand_t *dir, file_hand_t *file, const char *name);
 static int     _fat_file_close(file_hand_t *file);
+static int     _fat_load_fat(fs_hand_t *fs, uint32_t n_clusters);
+
+#define FAT12_MAX_CLUSTERS (4084)  /**< Largest number of clusters on a FAT12 filesystem */
+#define FAT16_MAX_CLUSTERS (65524) /**< Largest number of clusters on a FAT16 filesystem */
 
 int fs_fat_init(fs_hand_t *fs, storage_hand_t *storage, off_t off) {
     memset(fs, 0, sizeof(fs_hand_t));
@@ -40,10 +56,17 @@ int fs_fat_init(fs_hand_t *fs, storage_hand_t *storage, off_t off) {
     fs->storage   = storage;
     fs->fs_offset = off;
 
-    fat_bootsector_t *bootsec = (fat_bootsector_t *)alloc(sizeof(fat_bootsector_t), ALLOC_FLAG_16B);
+    fat_bootsector_t *bootsec = (fat_bootsector_t *)alloc(sizeof(fat_bootsector_t), 0);
 
     /* Read bootsector */
-    if(storage->read(storage, bootsec, fs->fs_offset, 512) != 512) {
+    if(storage_read(storage, bootsec, fs->fs_offset, sizeof(fat_bootsector_t)) != sizeof(fat_bootsector_t)) {
+        free(bootsec);
+        return -1;
+    }
+
+    if(!bootsec->bytes_per_sector || !bootsec->sectors_per_cluster ||
+       ((bootsec->bytes_per_sector * bootsec->sectors_per_cluster) > 0x8000)) {
+        printf("fs_fat_init: Bad sector or cluster size\n");
         free(bootsec);
         return -1;
     }
@@ -61,234 +84,400 @@ int fs_fat_init(fs_hand_t *fs, storage_hand_t *storage, off_t off) {
     fdata->fat_offset    = bootsec->reserved_sectors    * fdata->sector_size;
     fdata->fat_size      = bootsec->sectors_per_fat     * fdata->sector_size;
 
+    /* The root directory sits in a fixed region ahead of the data clusters,
+     * so is described by a single extent */
+    off_t rootdir_offset = fdata->fat_offset + (fdata->fat_size * bootsec->fat_copies);
+    fdata->data_offset   = rootdir_offset + (bootsec->root_dir_entries * sizeof(fat_dirent_t));
+
+    fdata->_rootdir_extent.index   = 0;
+    fdata->_rootdir_extent.length  = ((fdata->data_offset - rootdir_offset) + fdata->cluster_size - 1) /
+                                     fdata->cluster_size;
+    fdata->_rootdir_extent.offset  = rootdir_offset;
+    fdata->_rootdir_data.extents   = &fdata->_rootdir_extent;
+    fdata->_rootdir_data.n_extents = 1;
+    fdata->_rootdir_data.cursor    = 0;
+
     fdata->rootdir.size                = 0;
-    fdata->_rootdir_data.first_cluster = fdata->fat_offset + (fdata->fat_size * bootsec->fat_copies);
     fdata->rootdir.data                = &fdata->_rootdir_data;
     fdata->rootdir.attr                = FS_FILEATTR_DIRECTORY;
     fdata->rootdir.fs                  = fs;
     fdata->rootdir.read                = _fat_file_read;
+    fdata->rootdir.readv               = _fat_file_readv;
     fdata->rootdir.close               = _fat_file_close;
 
-    fdata->data_offset = fdata->_rootdir_data.first_cluster + (bootsec->root_dir_entries * sizeof(fat_dirent_t));
-
-    /* @note Currently only supporting FAT12 */
-    fs->fs_size = bootsec->total_sectors * fdata->sector_size;
+    uint32_t total_sectors = bootsec->total_sectors ? bootsec->total_sectors : bootsec->total_sectors_big;
+    uint32_t meta_sectors  = fdata->data_offset / fdata->sector_size;
+    if(total_sectors <= meta_sectors) {
+        printf("fs_fat_init: No data clusters\n");
+        free(bootsec);
+        goto fat_init_fail;
+    }
 
-    fdata->cache.buf = alloc(fdata->cluster_size * FAT_CACHE_CNT, 0);
+    /* The FAT type is determined solely by the number of clusters */
+    uint32_t n_clusters = (total_sectors - meta_sectors) / bootsec->sectors_per_cluster;
+    if(n_clusters <= FAT12_MAX_CLUSTERS) {
+        fdata->type = 12;
+    } else if(n_clusters <= FAT16_MAX_CLUSTERS) {
+        fdata->type = 16;
+    } else {
+        printf("fs_fat_init: FAT32 is not supported\n");
+        free(bootsec);
+        goto fat_init_fail;
+    }
 
     free(bootsec);
 
-    return 0;
-}
-
-/**
- * @brief Touch FAT cache entry, setting its rank to zero
- *
- * @param fdata FAT data structure
- * @param idx Cache entry to touch
- */
-static void _fat_cache_touch(fat_data_t *fdata, unsigned idx) {
-    for(unsigned i = 0; i < FAT_CACHE_CNT; i++) {
-        if(i == idx) {
-            continue;
-        }
-        if(fdata->cache.rank[i] < fdata->cache.rank[idx]) {
-            fdata->cache.rank[i]++;
-        }
+    /* @note Offsets are currently 32-bit signed, so only the first 2 GiB of the
+     * filesystem is accessible. */
+    uint64_t size = (uint64_t)total_sectors * fdata->sector_size;
+    if(size > INT_MAX) {
+        size = INT_MAX - (INT_MAX % fdata->sector_size);
     }
-    fdata->cache.rank[idx] = 0;
-}
+    fs->fs_size = (size_t)size;
 
-/**
- * @brief Retrieve cached FAT entry, if available
- *
- * @param fdata FAT data structure
- * @param buf Buffer to store cluster into
- * @param clust Cluster to search for
- * @return 1 on cache hit, 0 on cache miss
- */
-static int _fat_try_cache(fat_data_t *fdata, void *buf, off_t clust) {
-    for(unsigned i = 0; i < FAT_CACHE_CNT; i++) {
-        if(fdata->cache.clust[i] == clust) {
-            if(fdata->cache.rank[i] != 0) {
-                /* Update rank due to usage */
-                _fat_cache_touch(fdata, i);
-            }
-            memcpy(buf, fdata->cache.buf + (i * fdata->cluster_size), fdata->cluster_size);
-            return 1;
-        }
+    if(_fat_load_fat(fs, n_clusters)) {
+        goto fat_init_fail;
     }
+
+    /* Directories are scanned a sector at a time, so large clusters do not
+     * inflate the cache */
+    fs->cache = storage_cache_create(storage, fdata->sector_size);
+
+#if (DEBUG_FS_FAT)
+    printf("fs_fat_init: FAT%hhu, %u clusters of %hu bytes\n", fdata->type, n_clusters, fdata->cluster_size);
+#endif
+
     return 0;
+
+fat_init_fail:
+    free(fdata);
+    fs->data = NULL;
+
+    return -1;
 }
 
 /**
- * @brief Add cached FAT entry, overwriting oldest entry
+ * @brief Read the first FAT in a single request, and decode it into
+ * fat_data_t::fat, so following a cluster chain requires no I/O
  *
- * @param fdata FAT data structure
- * @param buf Buffer containing cluster data
- * @param clust Cluster address to store as
+ * @param fs Filesystem handle
+ * @param n_clusters Number of data clusters in the filesystem
+ * @return int 0 on success, else < 0
  */
-static void _fat_add_cache(fat_data_t *fdata, void *buf, off_t clust) {
-    unsigned entry = 0;
+static int _fat_load_fat(fs_hand_t *fs, uint32_t n_clusters) {
+    fat_data_t *fdata = (fat_data_t *)fs->data;
+    off_t       fat   = fs->fs_offset + fdata->fat_offset;
 
-    /* Find highest-rank (oldest) cache entry */
-    for(unsigned i = 1; i < FAT_CACHE_CNT; i++) {
-        if(fdata->cache.rank[i] > fdata->cache.rank[entry]) {
-            entry = i;
-        }
+    /* Entries 0 and 1 are reserved, so the table covers two more entries
+     * than there are data clusters. Anything beyond that is padding. */
+    uint32_t n_entries = (fdata->type == 12) ? ((fdata->fat_size * 2) / 3) : (fdata->fat_size / 2);
+    if(n_entries > (n_clusters + 2)) {
+        n_entries = n_clusters + 2;
     }
 
-    fdata->cache.clust[entry] = clust;
-    memcpy(fdata->cache.buf + (entry * fdata->cluster_size), buf, fdata->cluster_size);
-    _fat_cache_touch(fdata, entry);
-}
+    fdata->fat         = (uint16_t *)alloc(n_entries * sizeof(uint16_t), 0);
+    fdata->fat_entries = n_entries;
 
-static uint32_t _fat_read_fat_data(fs_hand_t *fs, void *tmp, off_t off, uint8_t sz) {
-    fat_data_t *fdata = (fat_data_t *)fs->data;
+    if(fdata->type == 16) {
+        /* Entries are already little-endian 16-bit values, so are read
+         * straight into place */
+        size_t fat_size = n_entries * sizeof(uint16_t);
+        if(storage_read(fs->storage, fdata->fat, fat, fat_size) != (ssize_t)fat_size) {
+            free(fdata->fat);
+            return -1;
+        }
+    } else {
+        /* Two entries are packed in every three bytes */
+        size_t   raw_size = ((n_entries * 3) + 1) / 2;
+        uint8_t *raw      = (uint8_t *)alloc(raw_size, 0);
+        if(storage_read(fs->storage, raw, fat, raw_size) != (ssize_t)raw_size) {
+            free(raw);
+            free(fdata->fat);
+            return -1;
+        }
 
-    off_t read_addr = off - (off % fdata->sector_size);
+        for(uint32_t i = 0; i < n_entries; i++) {
+            const uint8_t *ent = &raw[(i * 3) / 2];
+            uint16_t       val = ent[0] | (ent[1] << 8);
 
-    if(!_fat_try_cache(fdata, tmp, read_addr)) {
-        if(fs->storage->read(fs->storage, tmp, read_addr, fdata->cluster_size) != fdata->cluster_size) {
-            return 0xffffffff;
+            fdata->fat[i] = (i & 1) ? (val >> 4) : (val & 0xfff);
         }
-        _fat_add_cache(fdata, tmp, read_addr);
-    }
 
-    uint32_t data = *(uint32_t *)(tmp + (off - read_addr));
-
-    switch(sz) {
-        case 1: return data & 0x000000FF;
-        case 2: return data & 0x0000FFFF;
-        case 3: return data & 0x00FFFFFF;
-        case 4: return data & 0xFFFFFFFF;
+        free(raw);
     }
 
-    return 0xFFFFFFFF;
-}
+#if (DEBUG_FS_FAT)
+    printf("_fat_load_fat: %u entries\n", n_entries);
+#endif
 
-static uint32_t _fat_get_fat_entry(fs_hand_t *fs, void *tmp, uint32_t clust_num) {
-    fat_data_t *fdata = (fat_data_t *)fs->data;
+    return 0;
+}
 
-    /* @note Only FAT12 at the moment */
-    off_t fat_entry_offset = fdata->fat_offset + ((clust_num * 3) / 2);
+int fs_fat_geometry(const fat_bootsector_t *bootsec, uint16_t sector_size, fat_geometry_t *geom) {
+    uint32_t total = bootsec->total_sectors ? bootsec->total_sectors : bootsec->total_sectors_big;
 
-    uint16_t fat_entry = 0;
-    if((fat_entry_offset % fdata->cluster_size) == (fdata->cluster_size - 1)) {
-        /* Split across cluster boundry */
-        fat_entry = _fat_read_fat_data(fs, tmp, fat_entry_offset, 1) |
-                    (_fat_read_fat_data(fs, tmp, fat_entry_offset + 1, 1) << 8);
-    } else {
-        fat_entry = _fat_read_fat_data(fs, tmp, fat_entry_offset, 2);
+    if((bootsec->signature         != 0xAA55)      ||
+       (bootsec->bytes_per_sector  != sector_size) ||
+       (bootsec->sectors_per_track == 0) || (bootsec->sectors_per_track > 63) ||
+       (bootsec->heads             == 0) || (bootsec->heads             > 255) ||
+       (total                      == 0)) {
+        return -1;
     }
 
-    if(clust_num & 1) {
-        fat_entry >>= 4;
-    }
+    geom->sectors_per_track = bootsec->sectors_per_track;
+    geom->heads             = bootsec->heads;
+    geom->total_sectors     = total;
 
-    return fat_entry & 0xfff;
+    return 0;
 }
 
-static off_t _fat_get_next_cluster(fs_hand_t *fs, void *tmp, off_t curr_clust) {
+static uint32_t _fat_get_fat_entry(fs_hand_t *fs, uint32_t clust_num) {
     const fat_data_t *fdata = (fat_data_t *)fs->data;
-    
-    if(curr_clust < fdata->data_offset) {
-        if(curr_clust < fdata->_rootdir_data.first_cluster) {
-            printf("ERROR: Cluster below root directory\n");
-            return 0;
-        }
 
-        if((curr_clust + fdata->cluster_size) < fdata->data_offset) {
-            /* Root directory is contiguous */
-            return curr_clust + fdata->cluster_size;
-        } else {
-            /* End of root directory */
-            return 0;
-        }
+    if(clust_num >= fdata->fat_entries) {
+        /* Outside of the table, treat as the end of the chain */
+        return 0;
     }
 
-    uint32_t clust_num = ((curr_clust - fdata->data_offset) / fdata->cluster_size) + 2;
-    uint32_t fat_entry = _fat_get_fat_entry(fs, tmp, clust_num);
+    return fdata->fat[clust_num];
+}
 
-    off_t next_clust = 0;
-    if((fat_entry >= 0x002) && (fat_entry <= 0xff0)) {
-        next_clust = fdata->data_offset + ((fat_entry - 2) * fdata->cluster_size);
+/**
+ * @brief Get the cluster following a cluster in its chain
+ *
+ * @param fs Filesystem handle
+ * @param clust_num Cluster number
+ * @return uint32_t Next cluster number, or 0 at the end of the chain
+ */
+static uint32_t _fat_get_next_cluster(fs_hand_t *fs, uint32_t clust_num) {
+    const fat_data_t *fdata     = (fat_data_t *)fs->data;
+    uint32_t          fat_entry = _fat_get_fat_entry(fs, clust_num);
+
+    /* Only values naming a data cluster continue the chain. The reserved,
+     * bad cluster and end of chain markers of both FAT12 and FAT16 lie above
+     * the highest cluster number. */
+    uint32_t next_clust = 0;
+    if((fat_entry >= 2) && (fat_entry < fdata->fat_entries)) {
+        next_clust = fat_entry;
     }
 
 #if (DEBUG_FS_FAT > 1)
-    printf("_fat_get_next_cluster: %3u (%5d) -> %3u (%5d)\n", clust_num, curr_clust, fat_entry, next_clust);
+    printf("_fat_get_next_cluster: %3u -> %3u\n", clust_num, fat_entry);
 #endif
 
     return next_clust;
 }
 
-static ssize_t _fat_file_read(const file_hand_t *file, void *buf, size_t sz, off_t off) {
-#if (DEBUG_FS_FAT)
-    printf("_fat_file_read(..., %p, %d, %d)\n", buf, sz, off);
-#endif
+/**
+ * @brief Follow a cluster chain, building the extent map of a file
+ *
+ * @param fs Filesystem handle
+ * @param filedata File data to populate the extent map of
+ * @param cluster First cluster of the file, 0 for an empty file
+ * @return int 0 on success, else < 0 if the chain is corrupt
+ */
+static int _fat_map_file(fs_hand_t *fs, fat_file_data_t *filedata, uint32_t cluster) {
+    const fat_data_t *fdata = (fat_data_t *)fs->data;
+
+    filedata->extents   = NULL;
+    filedata->n_extents = 0;
+    filedata->cursor    = 0;
+
+    /* The chain is walked twice, counting extents and then filling them in,
+     * so the map is allocated exactly once */
+    for(unsigned pass = 0; pass < 2; pass++) {
+        fat_extent_t *extent = NULL;
+        unsigned      n      = 0;
+        uint32_t      index  = 0;
+        uint32_t      prev   = 0;
+
+        for(uint32_t clust = cluster; clust >= 2; clust = _fat_get_next_cluster(fs, clust)) {
+            if((clust >= fdata->fat_entries) ||
+               (index >= fdata->fat_entries)) {
+                /* Out of range, or longer than the FAT itself, so looped */
+                printf("ERROR: Corrupt cluster chain starting at %u\n", cluster);
+                if(filedata->extents) {
+                    free(filedata->extents);
+                    filedata->extents = NULL;
+                }
+                return -1;
+            }
 
-    if(!(file->attr & FS_FILEATTR_DIRECTORY) &&
-       (off + sz) > file->size) {
-        panic("Attempt to read past end of file!");
+            if(n && (clust == (prev + 1))) {
+                if(pass) {
+                    extent->length++;
+                }
+            } else {
+                if(pass) {
+                    extent         = &filedata->extents[n];
+                    extent->index  = index;
+                    extent->length = 1;
+                    extent->offset = fdata->data_offset + ((clust - 2) * fdata->cluster_size);
+                }
+                n++;
+            }
+
+            prev = clust;
+            index++;
+        }
+
+        if(pass) {
+            filedata->n_extents = n;
+        } else if(n) {
+            filedata->extents = (fat_extent_t *)alloc(n * sizeof(fat_extent_t), 0);
+        } else {
+            break;
+        }
     }
 
-    fs_hand_t             *fs       = file->fs;
-    const fat_data_t      *fdata    = (fat_data_t *)fs->data;
-    const fat_file_data_t *filedata = (fat_file_data_t *)file->data;
+    return 0;
+}
 
-    void *tmp = alloc(fdata->cluster_size, ALLOC_FLAG_16B);
+/**
+ * @brief Find the extent that may contain a cluster. Files are mostly read
+ * in increasing-offset chunks, so the extent the last read ended in is
+ * checked first, then the extents following it are binary searched.
+ *
+ * @param filedata File data
+ * @param index Index of cluster within the file
+ * @return unsigned Index of the last extent starting at or before the cluster
+ */
+static unsigned _fat_find_extent(const fat_file_data_t *filedata, uint32_t index) {
+    unsigned lo = 0;
+    unsigned hi = filedata->n_extents;
+
+    if((filedata->cursor < hi) &&
+       (filedata->extents[filedata->cursor].index <= index)) {
+        lo = filedata->cursor;
+        if(index < (filedata->extents[lo].index + filedata->extents[lo].length)) {
+            return lo;
+        }
+    }
 
-    off_t cluster = filedata->first_cluster;
-    /* Get to the desired cluster. */
-    while(off >= fdata->cluster_size) {
-        cluster = _fat_get_next_cluster(fs, tmp, cluster);
-        if(!cluster) {
-#if (DEBUG_FS_FAT)
-            if(!(file->attr & FS_FILEATTR_DIRECTORY)) {
-                printf("ERROR: Unexpected end of file!\n");
-            }
-#endif
-            free(tmp);
-            return -1;
+    while((hi - lo) > 1) {
+        unsigned mid = lo + ((hi - lo) / 2);
+        if(filedata->extents[mid].index <= index) {
+            lo = mid;
+        } else {
+            hi = mid;
         }
-        off -= fdata->cluster_size;
     }
 
+    return lo;
+}
 
-    size_t pos = 0;
-    while(pos < sz) {
-        if(fs->storage->read(fs->storage, tmp, cluster, fdata->cluster_size) != fdata->cluster_size) {
-            free(tmp);
+static ssize_t _fat_file_read(const file_hand_t *file, void *buf, size_t sz, off_t off) {
 #if (DEBUG_FS_FAT)
-            printf("ERROR: Could not read from FS!\n");
+    printf("_fat_file_read(..., %p, %d, %d)\n", buf, sz, off);
 #endif
-            return -1;
+
+    const storage_seg_t seg = {
+        .buff   = buf,
+        .offset = off,
+        .size   = sz
+    };
+
+    return _fat_file_readv(file, &seg, 1);
+}
+
+static ssize_t _fat_file_readv(const file_hand_t *file, const storage_seg_t *segs, unsigned n_segs) {
+    fs_hand_t        *fs       = file->fs;
+    const fat_data_t *fdata    = (fat_data_t *)fs->data;
+    fat_file_data_t  *filedata = (fat_file_data_t *)file->data;
+
+    /* Each segment maps to at most one device read per extent it touches */
+    unsigned max_reads = 0;
+    size_t   total     = 0;
+    for(unsigned i = 0; i < n_segs; i++) {
+        if(!(file->attr & FS_FILEATTR_DIRECTORY) &&
+           (segs[i].offset + segs[i].size) > file->size) {
+            panic("Attempt to read past end of file!");
         }
+        unsigned max_touched = (segs[i].size / fdata->cluster_size) + 2;
+        max_reads += (max_touched < filedata->n_extents) ? max_touched : filedata->n_extents;
+        total     += segs[i].size;
+    }
 
-        if((sz - pos) <= (size_t)(fdata->cluster_size - off)) {
-            memcpy(buf + pos, tmp + off, sz - pos);
-        } else {
-            memcpy(buf + pos, tmp, fdata->cluster_size - off);
+    if(!total) {
+        return 0;
+    } else if(!max_reads) {
+        /* Empty file */
+        return -1;
+    }
 
-            cluster = _fat_get_next_cluster(fs, tmp, cluster);
-            if(!cluster) {
+    /* Most reads touch only a few extents, so avoid allocating for them */
+    storage_seg_t  local[FAT_LOCAL_READS];
+    storage_seg_t *reads   = (max_reads <= FAT_LOCAL_READS) ? local :
+                             (storage_seg_t *)alloc(max_reads * sizeof(storage_seg_t), 0);
+    unsigned       n_reads = 0;
+
+    /* Translate segments into device reads, one per extent touched. Reads
+     * continuing the previous one both on disk and in memory are merged. */
+    for(unsigned i = 0; i < n_segs; i++) {
+        off_t    off = segs[i].offset;
+        size_t   pos = 0;
+        unsigned ext = _fat_find_extent(filedata, off / fdata->cluster_size);
+
+        while(pos < segs[i].size) {
+            if(ext >= filedata->n_extents) {
 #if (DEBUG_FS_FAT)
                 if(!(file->attr & FS_FILEATTR_DIRECTORY)) {
                     printf("ERROR: Unexpected end of file!\n");
                 }
 #endif
-                free(tmp);
+                if(reads != local) {
+                    free(reads);
+                }
                 return -1;
             }
+
+            const fat_extent_t *extent = &filedata->extents[ext];
+            off_t ext_start = (off_t)extent->index * fdata->cluster_size;
+            off_t ext_end   = ext_start + ((off_t)extent->length * fdata->cluster_size);
+            if(off >= ext_end) {
+                ext++;
+                continue;
+            }
+
+            size_t len = ext_end - off;
+            if(len > (segs[i].size - pos)) {
+                len = segs[i].size - pos;
+            }
+
+            void          *buff = segs[i].buff + pos;
+            off_t          dev  = extent->offset + (off - ext_start);
+            storage_seg_t *read = n_reads ? &reads[n_reads - 1] : NULL;
+            if(read &&
+               ((read->offset + (off_t)read->size) == dev) &&
+               ((read->buff   + read->size)         == buff)) {
+                read->size += len;
+            } else {
+                read         = &reads[n_reads++];
+                read->buff   = buff;
+                read->offset = dev;
+                read->size   = len;
+            }
+
+            pos += len;
+            off += len;
         }
 
-        off = 0;
-        pos += fdata->cluster_size;
+        filedata->cursor = ext;
     }
 
-    free(tmp);
-    
-    return sz;
+    ssize_t ret = (ssize_t)total;
+    if(storage_readv(fs->storage, reads, n_reads) != ret) {
+#if (DEBUG_FS_FAT)
+        printf("ERROR: Could not read from FS!\n");
+#endif
+        ret = -1;
+    }
+
+    if(reads != local) {
+        free(reads);
+    }
+
+    return ret;
 }
 
 /**
@@ -325,17 +514,19 @@ static int _fat_strcmp(const char *fat_name, const char *filename) {
     return 0;
 }
 
-static void _fat_pop_file(fs_hand_t *fs, file_hand_t *file, const fat_dirent_t *dent) {
-    const fat_data_t *fdata = (fat_data_t *)fs->data;
-    
+static int _fat_pop_file(fs_hand_t *fs, file_hand_t *file, const fat_dirent_t *dent) {
     fat_file_data_t *filedata = (fat_file_data_t *)alloc(sizeof(fat_file_data_t), 0);
-    filedata->first_cluster = fdata->data_offset + ((dent->start_cluster - 2) * fdata->cluster_size);
+    if(_fat_map_file(fs, filedata, dent->start_cluster)) {
+        free(filedata);
+        return -1;
+    }
 
     memset(file, 0, sizeof(*file));
     file->fs    = fs;
     file->data  = filedata;
     file->size  = dent->filesize;
     file->read  = _fat_file_read;
+    file->readv = _fat_file_readv;
     file->close = _fat_file_close;
 
     if(dent->attr & FAT_DIRENT_ATTR_DIRECTORY) {
@@ -345,8 +536,10 @@ static void _fat_pop_file(fs_hand_t *fs, file_hand_t *file, const fat_dirent_t *
     }
 
 #if (DEBUG_FS_FAT)
-    printf("_fat_pop_file: %u (%d), %u, %2x\n", dent->start_cluster, filedata->first_cluster, file->size, file->attr);
+    printf("_fat_pop_file: %u, %u extents, %u, %2x\n", dent->start_cluster, filedata->n_extents, file->size, file->attr);
 #endif
+
+    return 0;
 }
 
 static int _fat_fs_find(fs_hand_t *fs, const file_hand_t *dir, file_hand_t *file, const char *name) {
@@ -366,42 +559,62 @@ static int _fat_fs_find(fs_hand_t *fs, const file_hand_t *dir, file_hand_t *file
 
     if(!strcmp(name, ".")) {
         /* Current directory, just copy data */
+        const fat_file_data_t *dirdata  = (fat_file_data_t *)dir->data;
+        fat_file_data_t       *filedata = (fat_file_data_t *)alloc(sizeof(fat_file_data_t), 0);
+
+        /* The extent map is copied too, so each handle can free its own */
+        filedata->n_extents = dirdata->n_extents;
+        filedata->cursor    = 0;
+        filedata->extents   = NULL;
+        if(dirdata->n_extents) {
+            filedata->extents = (fat_extent_t *)alloc(dirdata->n_extents * sizeof(fat_extent_t), 0);
+            memcpy(filedata->extents, dirdata->extents, dirdata->n_extents * sizeof(fat_extent_t));
+        }
+
         memcpy(file, dir, sizeof(file_hand_t));
-        file->data = alloc(sizeof(fat_file_data_t), 0);
-        memcpy(file->data, dir->data, sizeof(fat_file_data_t));
+        file->data = filedata;
         return 0;
     }
 
-    fat_dirent_t *dirents = (fat_dirent_t *)alloc(fdata->cluster_size, 0);
+    const fat_file_data_t *dirdata = (fat_file_data_t *)dir->data;
 
-    off_t pos = 0;
-    while(1) {
-        /* Read one cluster at a time. */
-        if(_fat_file_read(dir, dirents, fdata->cluster_size, pos) != fdata->cluster_size) {
-            /* Assume end of directory. */
-            break;
+    unsigned base = 0;
+    for(unsigned ext = 0; ext < dirdata->n_extents; ext++) {
+        const fat_extent_t *extent = &dirdata->extents[ext];
+
+        off_t end = extent->offset + ((off_t)extent->length * fdata->cluster_size);
+        if((extent->offset < fdata->data_offset) && (end > fdata->data_offset)) {
+            /* The root directory need not fill its last cluster */
+            end = fdata->data_offset;
         }
 
-        for(unsigned i = 0; i < (fdata->cluster_size / sizeof(fat_dirent_t)); i++) {
-#if (DEBUG_FS_FAT)
-            if(dirents[i].filename[0]) {
-                printf("  %3u: %11s\n", (i + (pos / sizeof(fat_dirent_t))), dirents[i].filename);
+        for(off_t block = extent->offset; block < end; block += fdata->sector_size) {
+            /* Directory sectors are examined in place within the block cache */
+            const fat_dirent_t *dirents = storage_cache_get(fs->cache, block);
+            if(!dirents) {
+                return -1;
             }
+
+            for(unsigned i = 0; i < (fdata->sector_size / sizeof(fat_dirent_t)); i++) {
+                if(!dirents[i].filename[0]) {
+                    /* No further entries are in use */
+                    return -1;
+                }
+#if (DEBUG_FS_FAT)
+                printf("  %3u: %11s\n", (i + base), dirents[i].filename);
 #endif
-            if(!_fat_strcmp(dirents[i].filename, name) &&
-               !(dirents[i].attr & (FAT_DIRENT_ATTR_VOLUMELABEL |
-                                    FAT_DIRENT_ATTR_DEVICE      |
-                                    FAT_DIRENT_ATTR_RESERVED))) {
-                _fat_pop_file(fs, file, &dirents[i]);
-                free(dirents);
-                return 0;
+                if(!_fat_strcmp(dirents[i].filename, name) &&
+                   !(dirents[i].attr & (FAT_DIRENT_ATTR_VOLUMELABEL |
+                                        FAT_DIRENT_ATTR_DEVICE      |
+                                        FAT_DIRENT_ATTR_RESERVED))) {
+                    return _fat_pop_file(fs, file, &dirents[i]);
+                }
             }
-        }
 
-        pos += fdata->cluster_size;
+            base += fdata->sector_size / sizeof(fat_dirent_t);
+        }
     }
 
-    free(dirents);
     return -1;
 }
 
@@ -412,7 +625,11 @@ static int _fat_file_close(file_hand_t *file) {
         panic("Attempted to destroy static root directory!");
     }
 
-    free(file->data);    
+    fat_file_data_t *filedata = (fat_file_data_t *)file->data;
+    if(filedata->extents) {
+        free(filedata->extents);
+    }
+    free(filedata);
 
     return 0;
 }
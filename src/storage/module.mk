@@ -1,9 +1,34 @@
 
+obj-$(CONFIG_STORAGE_AHCI) += $(MDIR)ahci.o
+obj-$(CONFIG_STORAGE_ATA) += $(MDIR)ata.o
 obj-y += $(MDIR)bios.o
+obj-y += $(MDIR)bounce.o
+obj-y += $(MDIR)cache.o
+obj-$(CONFIG_STORAGE_FDC) += $(MDIR)fdc.o
 obj-y += $(MDIR)file.o
+obj-$(CONFIG_STORAGE_NVME) += $(MDIR)nvme.o
+obj-$(CONFIG_STORAGE_RAMDISK) += $(MDIR)ramdisk.o
+obj-$(CONFIG_STORAGE_REMOTE) += $(MDIR)remote.o
+obj-y += $(MDIR)sched.o
+obj-y += $(MDIR)storage.o
+obj-$(CONFIG_STORAGE_VIRTIO) += $(MDIR)virtio.o
 
 dirs-y = fs
 dirs-$(CONFIG_PROTOCOL) += protocol
 
 include $(patsubst %,$(MDIR)%/module.mk,$(dirs-y))
 
+cflags-y += -DCONFIG_STORAGE_BIOS_BOUNCE_SIZE=$(CONFIG_STORAGE_BIOS_BOUNCE_SIZE)
+cflags-$(CONFIG_STORAGE_BIOS_TRACKCACHE) += -DCONFIG_STORAGE_BIOS_TRACKCACHE \
+                                            -DCONFIG_STORAGE_BIOS_TRACKCACHE_CNT=$(CONFIG_STORAGE_BIOS_TRACKCACHE_CNT)
+cflags-y += -DCONFIG_STORAGE_CACHE_CNT=$(CONFIG_STORAGE_CACHE_CNT)
+cflags-$(CONFIG_STORAGE_FDC) += -DCONFIG_STORAGE_FDC
+cflags-$(CONFIG_STORAGE_ATA) += -DCONFIG_STORAGE_ATA
+cflags-$(CONFIG_STORAGE_ATA_DMA) += -DCONFIG_STORAGE_ATA_DMA
+cflags-$(CONFIG_STORAGE_AHCI) += -DCONFIG_STORAGE_AHCI
+cflags-$(CONFIG_STORAGE_VIRTIO) += -DCONFIG_STORAGE_VIRTIO
+cflags-$(CONFIG_STORAGE_NVME) += -DCONFIG_STORAGE_NVME
+cflags-$(CONFIG_STORAGE_RAMDISK) += -DCONFIG_STORAGE_RAMDISK \
+                                      -DCONFIG_STORAGE_RAMDISK_ADDR=$(CONFIG_STORAGE_RAMDISK_ADDR)
+cflags-$(CONFIG_STORAGE_REMOTE) += -DCONFIG_STORAGE_REMOTE
+cflags-$(CONFIG_STORAGE_REPORT) += -DCONFIG_STORAGE_REPORT
@@ -0,0 +1,419 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "io/output.h"
+#include "mm/alloc.h"
+#include "pci/pci.h"
+#include "storage/nvme.h"
+#include "time/time.h"
+
+/* @note since we currently allow only a single device open at a time, having
+ * this statically declared should be fine. */
+static storage_nvme_data_t _nvme_data = { 0 };
+
+#define NVME_TIMEOUT_CMD (5000) /**< Timeout for a command to complete, in ms */
+
+/** Keep the compiler from moving queue updates past MMIO accesses */
+#define _nvme_barrier() asm volatile("" ::: "memory")
+
+/** Pages allocated at init: admin SQ, admin CQ, I/O SQ, I/O CQ, PRP lists */
+#define NVME_PAGES (5)
+
+static ssize_t _read(storage_hand_t *storage, void *buff, off_t offset, size_t size);
+static int     _nvme_enable(storage_nvme_data_t *ndata, void *pages);
+static int     _nvme_identify(storage_nvme_data_t *ndata, void *ident);
+
+int storage_nvme_init(storage_hand_t *storage, uint8_t index) {
+    memset(storage, 0, sizeof(storage_hand_t));
+    memset(&_nvme_data, 0, sizeof(_nvme_data));
+    _nvme_data.stats = &storage->stats;
+
+    pci_addr_t pci;
+    for(unsigned i = 0; !pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_STORAGE_NVM, i, &pci); i++) {
+        if(pci_read8(pci, PCI_REG_PROGIF) != NVME_PROGIF) {
+            continue;
+        }
+        if(index--) {
+            continue;
+        }
+
+        _nvme_data.mmio = pci_bar(pci, NVME_BAR);
+        if(!_nvme_data.mmio) {
+            return -1;
+        }
+        pci_enable(pci, PCI_COMMAND_MEMORY | PCI_COMMAND_MASTER);
+
+        void *pages = alloc(NVME_PAGES * STORAGE_NVME_PAGE_SIZE, ALLOC_FLAG_ALIGN(NVME_ALIGN_PAGE));
+        if(!pages) {
+            panic("Could not allocate NVMe queues!");
+        }
+        memset(pages, 0, NVME_PAGES * STORAGE_NVME_PAGE_SIZE);
+
+        if(_nvme_enable(&_nvme_data, pages)) {
+            printf("storage_nvme: Controller did not become ready\n");
+            return -1;
+        }
+
+        /* The PRP list page doubles as the identify buffer, as no reads are
+         * in flight yet */
+        if(_nvme_identify(&_nvme_data, _nvme_data.prp)) {
+            printf("storage_nvme: Could not identify namespace\n");
+            return -1;
+        }
+
+        /* @note Offsets are currently 32-bit signed, so only the first 2 GiB of the
+         * drive is accessible. */
+        uint64_t size = (uint64_t)_nvme_data.n_blocks * _nvme_data.block_size;
+        if(size > INT_MAX) {
+            size = INT_MAX - (INT_MAX % _nvme_data.block_size);
+        }
+        storage->size = (size_t)size;
+
+#if (DEBUG_STORAGE_NVME)
+        printf("storage_nvme: Controller at %08x, namespace %u, %u x %hu byte blocks, %u bytes per command\n",
+               _nvme_data.mmio, _nvme_data.nsid, _nvme_data.n_blocks, _nvme_data.block_size,
+               _nvme_data.max_xfer);
+#endif
+
+        storage->block_size = _nvme_data.block_size;
+        storage->buff_align = 4; /* PRP entries must be dword aligned */
+        storage->data       = &_nvme_data;
+        storage->read       = _read;
+
+        return 0;
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Wait for the controller ready flag to reach the given state
+ *
+ * @param ndata NVMe storage data
+ * @param rdy Expected state of CSTS.RDY
+ * @param ms Timeout in milliseconds
+ * @return int 0 on success, < 0 on timeout or fatal controller status
+ */
+static int _nvme_wait_ready(storage_nvme_data_t *ndata, uint32_t rdy, uint32_t ms) {
+    time_ticks_t timeout;
+    time_offset(&timeout, ms);
+
+    uint32_t csts;
+    while(((csts = NVME_REG(ndata->mmio, NVME_REG_CSTS)) & NVME_CSTS_RDY) != rdy) {
+        if((csts & NVME_CSTS_CFS) || time_ispast(&timeout)) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Get the next free submission queue entry, cleared
+ *
+ * @param q Queue pair
+ * @return nvme_sqe_t* Submission queue entry
+ */
+static nvme_sqe_t *_nvme_sqe(storage_nvme_queue_t *q) {
+    nvme_sqe_t *sqe = &q->sq[q->tail];
+    memset(sqe, 0, sizeof(nvme_sqe_t));
+    return sqe;
+}
+
+/**
+ * @brief Hand the entry returned by _nvme_sqe() to the controller
+ *
+ * @param ndata NVMe storage data
+ * @param q Queue pair
+ */
+static void _nvme_submit(storage_nvme_data_t *ndata, storage_nvme_queue_t *q) {
+    q->tail = (q->tail + 1) % q->size;
+    _nvme_barrier();
+    NVME_REG(ndata->mmio, NVME_REG_DOORBELL + (2 * q->qid * ndata->dstrd)) = q->tail;
+}
+
+/**
+ * @brief Consume a single completion queue entry, if one is available
+ *
+ * @param ndata NVMe storage data
+ * @param q Queue pair
+ * @param cid Where to store the identifier of the completed command
+ * @return int Status of the completed command, 0 on success, or < 0 if no
+ * command has completed
+ */
+static int _nvme_complete(storage_nvme_data_t *ndata, storage_nvme_queue_t *q, uint16_t *cid) {
+    volatile nvme_cqe_t *cqe = &q->cq[q->head];
+    if((cqe->status & NVME_CQE_PHASE) != q->phase) {
+        return -1;
+    }
+    _nvme_barrier();
+
+    *cid       = cqe->cid;
+    int status = NVME_CQE_STATUS(cqe->status);
+
+    if(++q->head == q->size) {
+        q->head  = 0;
+        q->phase ^= 1;
+    }
+    NVME_REG(ndata->mmio, NVME_REG_DOORBELL + (((2 * q->qid) + 1) * ndata->dstrd)) = q->head;
+
+    return status;
+}
+
+/**
+ * @brief Submit the admin command last returned by _nvme_sqe(), and wait for
+ * it to complete
+ *
+ * @param ndata NVMe storage data
+ * @return int 0 on success, else < 0
+ */
+static int _nvme_admin(storage_nvme_data_t *ndata) {
+    _nvme_submit(ndata, &ndata->admin);
+
+    time_ticks_t timeout;
+    time_offset(&timeout, NVME_TIMEOUT_CMD);
+
+    int      status;
+    uint16_t cid;
+    while((status = _nvme_complete(ndata, &ndata->admin, &cid)) < 0) {
+        if(time_ispast(&timeout)) {
+            return -1;
+        }
+    }
+
+    return status ? -1 : 0;
+}
+
+/**
+ * @brief Reset the controller, set up the admin queues, and create the I/O
+ * queue pair
+ *
+ * @param ndata NVMe storage data, with `mmio` populated
+ * @param pages NVME_PAGES zeroed, page-aligned pages
+ * @return int 0 on success, else < 0
+ */
+static int _nvme_enable(storage_nvme_data_t *ndata, void *pages) {
+    uint32_t cap  = NVME_REG(ndata->mmio, NVME_REG_CAP);
+    uint32_t mqes = NVME_CAP_MQES(cap);
+    uint32_t to   = (NVME_CAP_TO(cap) + 1) * 500;
+    ndata->dstrd  = 4U << NVME_CAPH_DSTRD(NVME_REG(ndata->mmio, NVME_REG_CAPH));
+
+    NVME_REG(ndata->mmio, NVME_REG_CC) &= ~NVME_CC_EN;
+    if(_nvme_wait_ready(ndata, 0, to)) {
+        return -1;
+    }
+
+    uintptr_t page = (uintptr_t)pages;
+    ndata->admin.sq    = (nvme_sqe_t *)page;
+    ndata->admin.cq    = (volatile nvme_cqe_t *)(page + STORAGE_NVME_PAGE_SIZE);
+    ndata->admin.size  = STORAGE_NVME_ADMIN_SIZE;
+    ndata->admin.phase = 1;
+    ndata->admin.qid   = 0;
+    ndata->io.sq       = (nvme_sqe_t *)(page + (2 * STORAGE_NVME_PAGE_SIZE));
+    ndata->io.cq       = (volatile nvme_cqe_t *)(page + (3 * STORAGE_NVME_PAGE_SIZE));
+    ndata->io.size     = (mqes < STORAGE_NVME_IO_SIZE) ? mqes : STORAGE_NVME_IO_SIZE;
+    ndata->io.phase    = 1;
+    ndata->io.qid      = 1;
+    ndata->prp         = (uint64_t *)(page + (4 * STORAGE_NVME_PAGE_SIZE));
+
+    NVME_REG(ndata->mmio, NVME_REG_AQA)     = ((STORAGE_NVME_ADMIN_SIZE - 1) << 16) |
+                                              (STORAGE_NVME_ADMIN_SIZE - 1);
+    NVME_REG(ndata->mmio, NVME_REG_ASQ)     = (uintptr_t)ndata->admin.sq;
+    NVME_REG(ndata->mmio, NVME_REG_ASQ + 4) = 0;
+    NVME_REG(ndata->mmio, NVME_REG_ACQ)     = (uintptr_t)ndata->admin.cq;
+    NVME_REG(ndata->mmio, NVME_REG_ACQ + 4) = 0;
+    /* Completion is polled */
+    NVME_REG(ndata->mmio, NVME_REG_INTMS)   = 0xFFFFFFFF;
+
+    NVME_REG(ndata->mmio, NVME_REG_CC) = NVME_CC_IOSQES(6) | NVME_CC_IOCQES(4) | NVME_CC_EN;
+    if(_nvme_wait_ready(ndata, NVME_CSTS_RDY, to)) {
+        return -1;
+    }
+
+    /* The completion queue must exist before the submission queue using it */
+    nvme_sqe_t *sqe = _nvme_sqe(&ndata->admin);
+    sqe->opcode = NVME_ADMIN_CREATE_CQ;
+    sqe->prp1   = (uintptr_t)ndata->io.cq;
+    sqe->cdw10  = ((uint32_t)(ndata->io.size - 1) << 16) | ndata->io.qid;
+    sqe->cdw11  = NVME_QUEUE_PC;
+    if(_nvme_admin(ndata)) {
+        return -1;
+    }
+
+    sqe = _nvme_sqe(&ndata->admin);
+    sqe->opcode = NVME_ADMIN_CREATE_SQ;
+    sqe->prp1   = (uintptr_t)ndata->io.sq;
+    sqe->cdw10  = ((uint32_t)(ndata->io.size - 1) << 16) | ndata->io.qid;
+    sqe->cdw11  = ((uint32_t)ndata->io.qid << 16) | NVME_QUEUE_PC;
+
+    return _nvme_admin(ndata);
+}
+
+/**
+ * @brief Identify the controller and its first namespace
+ *
+ * @param ndata NVMe storage data
+ * @param ident Page-aligned buffer of STORAGE_NVME_PAGE_SIZE bytes
+ * @return int 0 on success, else < 0
+ */
+static int _nvme_identify(storage_nvme_data_t *ndata, void *ident) {
+    const uint8_t *id = ident;
+
+    nvme_sqe_t *sqe = _nvme_sqe(&ndata->admin);
+    sqe->opcode = NVME_ADMIN_IDENTIFY;
+    sqe->prp1   = (uintptr_t)ident;
+    sqe->cdw10  = NVME_IDENTIFY_CTRL;
+    if(_nvme_admin(ndata)) {
+        return -1;
+    }
+
+    /* Each command may need a PRP list, which must fit in the slot's run */
+    ndata->max_xfer = STORAGE_NVME_CHUNK;
+    if(id[NVME_IDCTRL_MDTS] && (id[NVME_IDCTRL_MDTS] < 16)) {
+        uint32_t mdts = (uint32_t)STORAGE_NVME_PAGE_SIZE << id[NVME_IDCTRL_MDTS];
+        if(mdts < ndata->max_xfer) {
+            ndata->max_xfer = mdts;
+        }
+    }
+
+    ndata->nsid = 1;
+    sqe = _nvme_sqe(&ndata->admin);
+    sqe->opcode = NVME_ADMIN_IDENTIFY;
+    sqe->nsid   = ndata->nsid;
+    sqe->prp1   = (uintptr_t)ident;
+    sqe->cdw10  = NVME_IDENTIFY_NS;
+    if(_nvme_admin(ndata)) {
+        return -1;
+    }
+
+    const uint32_t *nsze  = (const uint32_t *)&id[NVME_IDNS_NSZE];
+    uint8_t         flbas = id[NVME_IDNS_FLBAS] & 0x0F;
+    uint8_t         lbads = id[NVME_IDNS_LBAF + (flbas * 4) + 2];
+    if((lbads < 9) || (lbads > 12)) {
+        /* Only 512 to 4096 byte blocks are supported */
+        return -1;
+    }
+    ndata->block_size = 1U << lbads;
+    /* Only the first 2^32 blocks are usable regardless */
+    ndata->n_blocks   = nsze[1] ? 0xFFFFFFFF : nsze[0];
+
+    return ndata->n_blocks ? 0 : -1;
+}
+
+/**
+ * @brief Submit a read command on the I/O queue
+ *
+ * @param ndata NVMe storage data
+ * @param cid Command slot to use, must not be busy
+ * @param buff Buffer to read into, must be 4-byte aligned
+ * @param lba First block to read
+ * @param count Number of blocks to read, at most `max_xfer` bytes
+ */
+static void _nvme_read_command(storage_nvme_data_t *ndata, uint16_t cid, void *buff, uint32_t lba, uint32_t count) {
+    ndata->stats->xfers++;
+    ndata->stats->read += count * ndata->block_size;
+
+    nvme_sqe_t *sqe = _nvme_sqe(&ndata->io);
+    sqe->opcode = NVME_CMD_READ;
+    sqe->cid    = cid;
+    sqe->nsid   = ndata->nsid;
+    sqe->cdw10  = lba;
+    sqe->cdw12  = count - 1;
+
+    /* The PRPs point straight at the destination. The first entry may start
+     * mid-page, every following entry covers a whole page. */
+    uintptr_t addr = (uintptr_t)buff;
+    uint32_t  len  = count * ndata->block_size;
+    uint32_t  first = STORAGE_NVME_PAGE_SIZE - (addr % STORAGE_NVME_PAGE_SIZE);
+    sqe->prp1 = addr;
+    if(len > first) {
+        addr += first;
+        len  -= first;
+        if(len <= STORAGE_NVME_PAGE_SIZE) {
+            sqe->prp2 = addr;
+        } else {
+            uint64_t *list = &ndata->prp[cid * STORAGE_NVME_PRP_CNT];
+            for(unsigned i = 0; len; i++) {
+                list[i] = addr;
+                addr   += STORAGE_NVME_PAGE_SIZE;
+                len     = (len > STORAGE_NVME_PAGE_SIZE) ? (len - STORAGE_NVME_PAGE_SIZE) : 0;
+            }
+            sqe->prp2 = (uintptr_t)list;
+        }
+    }
+
+    ndata->busy |= (1UL << cid);
+    _nvme_submit(ndata, &ndata->io);
+}
+
+static ssize_t _read(storage_hand_t *storage, void *buff, off_t offset, size_t size) {
+#if (DEBUG_STORAGE_NVME)
+    printf("_nvme_read(..., %p, %5d, %4d)", buff, offset, size);
+#endif
+
+    storage_nvme_data_t *ndata = (storage_nvme_data_t *)storage->data;
+
+    if((offset % ndata->block_size) || (size % ndata->block_size)) {
+        /* Currently only support block-aligned reads */
+        panic("Address or size not aligned to sector count!");
+    }
+    if(offset < 0) {
+        panic("Negative offset!");
+    }
+    if((uintptr_t)buff & 3) {
+        panic("NVMe buffer not 4-byte aligned!");
+    }
+
+    uint32_t lba   = offset / ndata->block_size;
+    uint32_t count = size   / ndata->block_size;
+    uint32_t max   = ndata->max_xfer / ndata->block_size;
+    int      err   = 0;
+
+    time_ticks_t timeout;
+    time_offset(&timeout, NVME_TIMEOUT_CMD);
+
+    /* Keep the I/O queue as full as possible, topping it up as commands
+     * complete. On error, stop submitting and drain what is outstanding, as
+     * the controller may still be writing to it. */
+    while((count && !err) || ndata->busy) {
+        for(uint16_t cid = 0; (cid < (ndata->io.size - 1)) && count && !err; cid++) {
+            if(ndata->busy & (1UL << cid)) {
+                continue;
+            }
+            uint32_t run = (count > max) ? max : count;
+            _nvme_read_command(ndata, cid, buff, lba, run);
+
+            buff  += run * ndata->block_size;
+            lba   += run;
+            count -= run;
+        }
+
+        int      status;
+        uint16_t cid;
+        if((status = _nvme_complete(ndata, &ndata->io, &cid)) >= 0) {
+            ndata->busy &= ~(1UL << cid);
+            if(status) {
+                ndata->stats->failures++;
+                err = 1;
+            }
+            time_offset(&timeout, NVME_TIMEOUT_CMD);
+            status_working(WORKING_STATUS_WORKING);
+        } else if(time_ispast(&timeout)) {
+            /* Commands still owned by the controller cannot be reused safely */
+            panic("NVMe command timed out!");
+        }
+    }
+
+    if(err) {
+#if (DEBUG_STORAGE_NVME)
+        printf(" FAIL [failures: %u]\n", ndata->stats->failures);
+#endif
+        return -1;
+    }
+
+#if (DEBUG_STORAGE_NVME)
+    printf(" OK\n");
+#endif
+
+    return (ssize_t)size;
+}
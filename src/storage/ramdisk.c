@@ -0,0 +1,92 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "io/output.h"
+#include "storage/file.h"
+#include "storage/ramdisk.h"
+
+/* @note Only a single image is loaded, so its location is kept here */
+static uintptr_t _image_begin = 0;
+static uintptr_t _image_end   = 0;
+
+static ssize_t _read(storage_hand_t *storage, void *buff, off_t offset, size_t size);
+static ssize_t _readv(storage_hand_t *storage, const storage_seg_t *segs, unsigned n_segs);
+
+int storage_ramdisk_init(storage_hand_t *storage, void *base, size_t size) {
+    memset(storage, 0, sizeof(storage_hand_t));
+
+    storage->size       = size;
+    /* Memory is byte-addressable, so nothing is ever staged */
+    storage->block_size = 1;
+    storage->data       = base;
+    storage->read       = _read;
+    storage->readv      = _readv;
+
+    return 0;
+}
+
+int storage_ramdisk_load(storage_hand_t *storage, const char *path) {
+    file_hand_t image;
+    if(file_open(&image, path)) {
+        printf("storage_ramdisk: Could not open `%s`\n", path);
+        return -1;
+    }
+
+    /* Images are generally larger than the heap in conventional memory, so
+     * are placed in extended memory */
+    void *base = (void *)CONFIG_STORAGE_RAMDISK_ADDR;
+    if(image.read(&image, base, image.size, 0) != (ssize_t)image.size) {
+        printf("storage_ramdisk: Could not read `%s`\n", path);
+        image.close(&image);
+        return -1;
+    }
+
+    size_t size = image.size;
+    image.close(&image);
+
+    _image_begin = (uintptr_t)base;
+    _image_end   = (uintptr_t)base + size;
+
+    return storage_ramdisk_init(storage, base, size);
+}
+
+int storage_ramdisk_overlaps(uintptr_t begin, uintptr_t end) {
+    return (begin < _image_end) && (end > _image_begin);
+}
+
+/**
+ * @brief Copy a range out of the image, clamped to the end of the image
+ */
+static ssize_t _ramdisk_copy(storage_hand_t *storage, void *buff, off_t offset, size_t size) {
+    if((offset < 0) || ((size_t)offset > storage->size)) {
+        return -1;
+    }
+    if(size > (storage->size - offset)) {
+        size = storage->size - offset;
+    }
+
+    memcpy(buff, (uint8_t *)storage->data + offset, size);
+
+    storage->stats.xfers++;
+    storage->stats.read += size;
+
+    return (ssize_t)size;
+}
+
+static ssize_t _read(storage_hand_t *storage, void *buff, off_t offset, size_t size) {
+    return _ramdisk_copy(storage, buff, offset, size);
+}
+
+static ssize_t _readv(storage_hand_t *storage, const storage_seg_t *segs, unsigned n_segs) {
+    ssize_t total = 0;
+
+    for(unsigned i = 0; i < n_segs; i++) {
+        if(_ramdisk_copy(storage, segs[i].buff, segs[i].offset, segs[i].size) != (ssize_t)segs[i].size) {
+            return -1;
+        }
+        total += segs[i].size;
+    }
+
+    return total;
+}
+
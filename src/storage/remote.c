@@ -0,0 +1,202 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "io/output.h"
+#include "io/serial.h"
+#include "storage/remote.h"
+
+/* @note since we currently allow only a single device open at a time, having
+ * this statically declared should be fine. */
+static storage_remote_data_t _remote_data = { 0 };
+
+static ssize_t _read(storage_hand_t *storage, void *buff, off_t offset, size_t size);
+static int     _remote_xfer(storage_remote_data_t *rdata, uint8_t cmd, void *buff, uint32_t offset, uint32_t size);
+
+int storage_remote_init(storage_hand_t *storage, const char *port) {
+    memset(storage, 0, sizeof(storage_hand_t));
+    memset(&_remote_data, 0, sizeof(_remote_data));
+    _remote_data.stats = &storage->stats;
+
+    uint32_t port_cfg;
+    if(!strncmp(port, "COM1", 4)) {
+        port_cfg = SERIAL_CFG_PORT_COM1;
+    } else if(!strncmp(port, "COM2", 4)) {
+        port_cfg = SERIAL_CFG_PORT_COM2;
+    } else if(!strncmp(port, "COM3", 4)) {
+        port_cfg = SERIAL_CFG_PORT_COM3;
+    } else if(!strncmp(port, "COM4", 4)) {
+        port_cfg = SERIAL_CFG_PORT_COM4;
+    } else {
+        printf("storage_remote: Bad serial port name `%s`\n", port);
+        return -1;
+    }
+
+    if(serial_init(&_remote_data.in, &_remote_data.out, CONFIG_SERIAL_BAUDRATE,
+                   ((port_cfg                << SERIAL_CFG_PORT__POS)         |
+                    (CONFIG_SERIAL_FIFO_SIZE << SERIAL_CFG_INBUFFSZ__POS)     |
+                    (CONFIG_SERIAL_FIFO_SIZE << SERIAL_CFG_OUTBUFFSZ__POS)    |
+#ifdef CONFIG_SERIAL_FLOWCONTROL_RTS
+                    (1                       << SERIAL_CFG_FLOWCTRL_RTS__POS) |
+#endif
+#ifdef CONFIG_SERIAL_FLOWCONTROL_DTR
+                    (1                       << SERIAL_CFG_FLOWCTRL_DTR__POS) |
+#endif
+                    0))) {
+        return -1;
+    }
+
+    uint32_t size;
+    if(_remote_xfer(&_remote_data, REMOTE_CMD_INFO, &size, 0, sizeof(size))) {
+        printf("storage_remote: No response from server on %s\n", port);
+        return -1;
+    }
+
+    /* @note Offsets are currently 32-bit signed, so only the first 2 GiB of the
+     * image is accessible. */
+    if(size > INT_MAX) {
+        size = INT_MAX;
+    }
+    storage->size = size;
+
+#if (DEBUG_STORAGE_REMOTE)
+    printf("storage_remote: Image of %u bytes on %s\n", size, port);
+#endif
+
+    /* Requests address bytes, so reads never need padding to a block */
+    storage->block_size = 1;
+    storage->data       = &_remote_data;
+    storage->read       = _read;
+
+    return 0;
+}
+
+/**
+ * @brief Calculate CRC-16-CCITT (XMODEM variant) of input data
+ *
+ * @param crc CRC of any preceding data, or REMOTE_CRC16_INIT
+ * @param data Data to calculate CRC over
+ * @param len Number of bytes of data
+ * @return uint16_t Resulting CRC
+ */
+static uint16_t _remote_crc16(uint16_t crc, const void *data, size_t len) {
+#define REMOTE_CRC16_INIT (0x0000U)
+#define REMOTE_CRC16_POLY (0x1021U)
+    const uint8_t *bdata = data;
+
+    for(size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)(bdata[i] << 8);
+
+        for(unsigned j = 0; j < 8; j++) {
+            if(crc & 0x8000) {
+                crc = (crc << 1) ^ REMOTE_CRC16_POLY;
+            } else {
+                crc = crc << 1;
+            }
+        }
+    }
+
+    return crc;
+}
+
+/**
+ * @brief Send a request and receive its response, retrying on timeouts and
+ * corrupted responses
+ *
+ * @param rdata Remote block driver data
+ * @param cmd Command, see `REMOTE_CMD_*`
+ * @param buff Buffer to receive payload into
+ * @param offset Offset into image
+ * @param size Expected payload size
+ * @return int 0 on success, else < 0
+ */
+static int _remote_xfer(storage_remote_data_t *rdata, uint8_t cmd, void *buff, uint32_t offset, uint32_t size) {
+    for(unsigned attempt = 0; attempt < REMOTE_RETRIES; attempt++) {
+        if(attempt) {
+            rdata->stats->retries++;
+            /* Throw away the remains of a bad response, so the next one is
+             * read from its start */
+            rdata->in.read(&rdata->in, NULL, REMOTE_MAX_XFER, 50);
+        }
+
+        /* A fresh sequence number each attempt keeps late responses to an
+         * earlier attempt from being taken for this one */
+        remote_req_t req = {
+            .magic  = REMOTE_MAGIC_REQ,
+            .cmd    = cmd,
+            .seq    = rdata->seq++,
+            .offset = offset,
+            .size   = size
+        };
+        req.crc = _remote_crc16(REMOTE_CRC16_INIT, &req, sizeof(req) - sizeof(req.crc));
+
+        rdata->stats->xfers++;
+        if(rdata->out.write(&rdata->out, &req, sizeof(req)) != sizeof(req)) {
+            continue;
+        }
+
+        remote_resp_t resp;
+        if((rdata->in.read(&rdata->in, &resp, sizeof(resp), REMOTE_TIMEOUT) != sizeof(resp)) ||
+           (resp.magic != REMOTE_MAGIC_RESP) ||
+           (resp.seq   != req.seq)           ||
+           (resp.size  >  size)) {
+            continue;
+        }
+
+        uint16_t crc;
+        if((rdata->in.read(&rdata->in, buff, resp.size, REMOTE_TIMEOUT) != (ssize_t)resp.size) ||
+           (rdata->in.read(&rdata->in, &crc, sizeof(crc), REMOTE_TIMEOUT) != sizeof(crc))) {
+            continue;
+        }
+
+        if(crc != _remote_crc16(_remote_crc16(REMOTE_CRC16_INIT, &resp, sizeof(resp)), buff, resp.size)) {
+#if (DEBUG_STORAGE_REMOTE)
+            printf("storage_remote: CRC mismatch on request %hu\n", req.seq);
+#endif
+            continue;
+        }
+
+        if(resp.status || (resp.size != size)) {
+            printf("storage_remote: Server rejected request %hhu @ %u, status %hhu\n",
+                   cmd, offset, resp.status);
+            rdata->stats->failures++;
+            return -1;
+        }
+
+        return 0;
+    }
+
+    rdata->stats->failures++;
+
+    return -1;
+}
+
+static ssize_t _read(storage_hand_t *storage, void *buff, off_t offset, size_t size) {
+    storage_remote_data_t *rdata = storage->data;
+
+    if((size_t)offset >= storage->size) {
+        return -1;
+    }
+    if(size > (storage->size - offset)) {
+        size = storage->size - offset;
+    }
+
+    size_t done = 0;
+    while(done < size) {
+        size_t chunk = size - done;
+        if(chunk > REMOTE_MAX_XFER) {
+            chunk = REMOTE_MAX_XFER;
+        }
+
+        if(_remote_xfer(rdata, REMOTE_CMD_READ, buff + done, offset + done, chunk)) {
+            return -1;
+        }
+
+        rdata->stats->read += chunk;
+        done               += chunk;
+
+        status_working(WORKING_STATUS_WORKING);
+    }
+
+    return (ssize_t)done;
+}
+
@@ -0,0 +1,177 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "mm/alloc.h"
+#include "storage/sched.h"
+
+/**
+ * @brief Device read serving a run of merged requests
+ */
+typedef struct {
+    storage_req_t  req;   /**< Read dispatched to the device */
+    storage_req_t *first; /**< First request served by this read */
+    unsigned       count; /**< Number of requests served */
+    void          *tmp;   /**< Staging buffer, or NULL if read straight into the requests' buffers */
+} storage_sched_run_t;
+
+void storage_sched_init(storage_sched_t *sched, storage_hand_t *storage, uint16_t align) {
+    memset(sched, 0, sizeof(*sched));
+
+    sched->storage = storage;
+    sched->align   = align;
+}
+
+void storage_sched_add(storage_sched_t *sched, storage_req_t *req) {
+    req->status = STORAGE_REQ_PENDING;
+
+    /* Requests usually arrive in ascending order, so check the tail first */
+    storage_req_t **link = &sched->pending;
+    if(sched->tail && (sched->tail->offset <= req->offset)) {
+        link = &sched->tail->next;
+    } else {
+        while(*link && ((*link)->offset <= req->offset)) {
+            link = &(*link)->next;
+        }
+    }
+
+    req->next = *link;
+    *link     = req;
+    if(!req->next) {
+        sched->tail = req;
+    }
+    sched->count++;
+}
+
+/**
+ * @brief Round offset up to the scheduler's alignment
+ */
+static off_t _sched_align_up(const storage_sched_t *sched, off_t off) {
+    return off + ((sched->align - (off % sched->align)) % sched->align);
+}
+
+/**
+ * @brief Collect the run of requests starting at req that can be served by a
+ * single device read, and submit that read
+ *
+ * @param sched Scheduler
+ * @param run Run to populate
+ * @param req First request of the run
+ * @return storage_req_t* First request following the run
+ */
+static storage_req_t *_sched_merge(storage_sched_t *sched, storage_sched_run_t *run, storage_req_t *req) {
+    off_t start  = req->offset;
+    off_t end    = req->offset + req->size;
+    int   direct = 1;
+
+    run->first = req;
+    run->count = 1;
+
+    storage_req_t *last = req;
+    for(req = req->next; req; req = req->next) {
+        off_t req_end = req->offset + req->size;
+        off_t new_end = (req_end > end) ? req_end : end;
+        if(req->offset < start) {
+            /* Wrapped around to the start of the disk */
+            break;
+        } else if(direct &&
+                  (req->offset == end) &&
+                  (req->buff   == (last->buff + last->size))) {
+            /* Continues both on disk and in memory */
+        } else if((req->offset > _sched_align_up(sched, end)) ||
+                  ((_sched_align_up(sched, new_end) - (start - (start % sched->align))) > STORAGE_SCHED_MERGE_MAX)) {
+            break;
+        } else {
+            /* Adjacent or overlapping, or sharing a block, so must be staged */
+            direct = 0;
+        }
+
+        end  = new_end;
+        last = req;
+        run->count++;
+    }
+
+    if(!direct) {
+        /* Staged reads are kept block-aligned, so they can still be issued
+         * asynchronously */
+        start -= start % sched->align;
+        end    = _sched_align_up(sched, end);
+    }
+
+    size_t size = end - start;
+    run->tmp        = direct ? NULL : alloc(size, 0);
+    run->req.buff   = direct ? run->first->buff : run->tmp;
+    run->req.offset = start;
+    run->req.size   = size;
+    run->req.done   = NULL;
+    if(storage_submit(sched->storage, &run->req)) {
+        run->req.status = -1;
+    }
+
+    sched->head = end;
+    sched->stats.reads++;
+    sched->stats.requests += run->count;
+
+    return req;
+}
+
+int storage_sched_run(storage_sched_t *sched) {
+    if(!sched->pending) {
+        return 0;
+    }
+
+    /* Elevator order: continue upwards from the end of the last batch, then
+     * wrap around to the lowest offset */
+    storage_req_t  *list = sched->pending;
+    storage_req_t **link = &sched->pending;
+    while(*link && ((*link)->offset < sched->head)) {
+        link = &(*link)->next;
+    }
+    if(*link && (link != &sched->pending)) {
+        list              = *link;
+        *link             = NULL;
+        sched->tail->next = sched->pending;
+    }
+
+    storage_sched_run_t *runs   = (storage_sched_run_t *)alloc(sched->count * sizeof(storage_sched_run_t), 0);
+    unsigned             n_runs = 0;
+
+    /* Everything is submitted up front, so asynchronous devices are kept busy
+     * while earlier reads are scattered */
+    while(list) {
+        list = _sched_merge(sched, &runs[n_runs++], list);
+    }
+
+    int ret = 0;
+    for(unsigned i = 0; i < n_runs; i++) {
+        storage_sched_run_t *run = &runs[i];
+
+        int ok = (storage_wait(sched->storage, &run->req) == (ssize_t)run->req.size);
+
+        storage_req_t *req = run->first;
+        for(unsigned j = 0; j < run->count; j++) {
+            storage_req_t *next = req->next;
+            if(!ok) {
+                storage_req_complete(req, -1);
+                ret = -1;
+            } else {
+                if(run->tmp) {
+                    memcpy(req->buff, run->tmp + (req->offset - run->req.offset), req->size);
+                }
+                storage_req_complete(req, (ssize_t)req->size);
+            }
+            req = next;
+        }
+
+        if(run->tmp) {
+            free(run->tmp);
+        }
+    }
+
+    free(runs);
+
+    sched->pending = NULL;
+    sched->tail    = NULL;
+    sched->count   = 0;
+
+    return ret;
+}
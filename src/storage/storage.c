@@ -0,0 +1,257 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "io/output.h"
+#include "mm/alloc.h"
+#include "storage/sched.h"
+#include "storage/storage.h"
+#include "time/time.h"
+
+static ssize_t _storage_read(storage_hand_t *storage, void *buff, off_t offset, size_t size);
+
+void storage_req_complete(storage_req_t *req, ssize_t status) {
+    req->next   = NULL;
+    req->status = status;
+    if(req->done) {
+        req->done(req);
+    }
+}
+
+/**
+ * @brief Account for a caller's request in the device statistics
+ *
+ * @param storage Storage device
+ * @param size Number of bytes requested
+ * @param start Tick count at the start of the request
+ */
+static void _storage_account(storage_hand_t *storage, size_t size, time_ticks_t start) {
+    time_ticks_t now;
+    time_get(&now);
+
+    storage->stats.requested += size;
+    storage->stats.ticks     += now - start;
+}
+
+ssize_t storage_read(storage_hand_t *storage, void *buff, off_t offset, size_t size) {
+    time_ticks_t start;
+    time_get(&start);
+
+    ssize_t ret = _storage_read(storage, buff, offset, size);
+
+    _storage_account(storage, size, start);
+
+    return ret;
+}
+
+/**
+ * @brief Check whether a buffer can be passed to the driver as-is
+ */
+static int _storage_buff_ok(const storage_hand_t *storage, const void *buff) {
+    return (storage->buff_align < 2) || !((uintptr_t)buff % storage->buff_align);
+}
+
+/**
+ * @brief Read a block-aligned range, staging it through a temporary buffer if
+ * buff does not meet the driver's alignment requirement
+ *
+ * @see storage_hand_t::read
+ */
+static ssize_t _storage_read_blocks(storage_hand_t *storage, void *buff, off_t offset, size_t size) {
+    if(_storage_buff_ok(storage, buff)) {
+        return storage->read(storage, buff, offset, size);
+    }
+
+    size_t chunk = STORAGE_STAGE_MAX - (STORAGE_STAGE_MAX % storage->block_size);
+    if(chunk > size) {
+        chunk = size;
+    }
+
+    /* @note Heap allocations are at least 4-byte aligned */
+    void  *tmp  = alloc(chunk, 0);
+    size_t done = 0;
+    while(done < size) {
+        size_t len = ((size - done) > chunk) ? chunk : (size - done);
+        if(storage->read(storage, tmp, offset + done, len) != (ssize_t)len) {
+            break;
+        }
+        memcpy(buff + done, tmp, len);
+        done += len;
+    }
+    free(tmp);
+
+    return (done == size) ? (ssize_t)size : -1;
+}
+
+/**
+ * @brief Read an arbitrary range of bytes, without accounting for it
+ *
+ * @see storage_read
+ */
+static ssize_t _storage_read(storage_hand_t *storage, void *buff, off_t offset, size_t size) {
+    const size_t bs   = storage->block_size;
+    size_t       head = offset % bs;
+
+    if(!head && !(size % bs)) {
+        return _storage_read_blocks(storage, buff, offset, size);
+    }
+
+    if(!storage->sbuff) {
+        storage->sbuff = alloc(bs, 0);
+    }
+
+    size_t done = 0;
+    if(head) {
+        /* Partial first block */
+        done = bs - head;
+        if(done > size) {
+            done = size;
+        }
+        if(storage->read(storage, storage->sbuff, offset - head, bs) != (ssize_t)bs) {
+            return -1;
+        }
+        memcpy(buff, storage->sbuff + head, done);
+    }
+
+    size_t middle = (size - done) - ((size - done) % bs);
+    if(middle) {
+        if(_storage_read_blocks(storage, buff + done, offset + done, middle) != (ssize_t)middle) {
+            return -1;
+        }
+        done += middle;
+    }
+
+    if(done < size) {
+        /* Partial last block */
+        if(storage->read(storage, storage->sbuff, offset + done, bs) != (ssize_t)bs) {
+            return -1;
+        }
+        memcpy(buff + done, storage->sbuff, size - done);
+    }
+
+    return (ssize_t)size;
+}
+
+int storage_submit(storage_hand_t *storage, storage_req_t *req) {
+    req->status = STORAGE_REQ_PENDING;
+    req->next   = NULL;
+
+    if(storage->submit &&
+       !(req->offset % storage->block_size) &&
+       !(req->size   % storage->block_size) &&
+       _storage_buff_ok(storage, req->buff)) {
+        return storage->submit(storage, req);
+    }
+
+    /* Synchronous fallback */
+    ssize_t ret = _storage_read(storage, req->buff, req->offset, req->size);
+    storage_req_complete(req, ret);
+
+    return 0;
+}
+
+void storage_poll(storage_hand_t *storage) {
+    if(storage->poll) {
+        storage->poll(storage);
+    }
+}
+
+ssize_t storage_wait(storage_hand_t *storage, storage_req_t *req) {
+    storage_poll(storage);
+    while(req->status == STORAGE_REQ_PENDING) {
+        /* Asynchronous drivers are interrupt driven, so nothing changes until
+         * the next interrupt */
+        asm volatile("hlt");
+        storage_poll(storage);
+    }
+
+    return req->status;
+}
+
+ssize_t storage_read_wait(storage_hand_t *storage, void *buff, off_t offset, size_t size) {
+    storage_req_t req = {
+        .buff   = buff,
+        .offset = offset,
+        .size   = size
+    };
+
+    if(storage_submit(storage, &req)) {
+        return -1;
+    }
+
+    return storage_wait(storage, &req);
+}
+
+ssize_t storage_readv(storage_hand_t *storage, const storage_seg_t *segs, unsigned n_segs) {
+    time_ticks_t start;
+    time_get(&start);
+
+    /* Requested bytes are accounted whether or not the read succeeds */
+    size_t total = 0;
+    for(unsigned i = 0; i < n_segs; i++) {
+        total += segs[i].size;
+    }
+
+    ssize_t ret;
+    if(storage->readv) {
+        ret = storage->readv(storage, segs, n_segs);
+    } else if(n_segs == 1) {
+        /* Nothing to merge or reorder */
+        ret = _storage_read(storage, segs[0].buff, segs[0].offset, segs[0].size);
+    } else {
+        if(!storage->sched) {
+            storage->sched = (storage_sched_t *)alloc(sizeof(storage_sched_t), 0);
+            storage_sched_init(storage->sched, storage, storage->block_size);
+        }
+
+        storage_req_t *reqs = (storage_req_t *)alloc(n_segs * sizeof(storage_req_t), 0);
+        for(unsigned i = 0; i < n_segs; i++) {
+            reqs[i].buff   = segs[i].buff;
+            reqs[i].offset = segs[i].offset;
+            reqs[i].size   = segs[i].size;
+            reqs[i].done   = NULL;
+            storage_sched_add(storage->sched, &reqs[i]);
+        }
+
+        ret = storage_sched_run(storage->sched) ? -1 : (ssize_t)total;
+
+        free(reqs);
+    }
+
+    _storage_account(storage, total, start);
+
+    return ret;
+}
+
+void storage_phase(storage_hand_t *storage, storage_phase_e phase) {
+    /* Every field is a uint32_t counter, so they can be handled as an array */
+    const uint32_t *total = (const uint32_t *)&storage->stats;
+    uint32_t       *mark  = (uint32_t *)&storage->phase_mark;
+    uint32_t       *cur   = (uint32_t *)&storage->phase_stats[storage->phase];
+
+    for(unsigned i = 0; i < (sizeof(storage_stats_t) / sizeof(uint32_t)); i++) {
+        cur[i] += total[i] - mark[i];
+        mark[i] = total[i];
+    }
+
+    storage->phase = phase;
+}
+
+void storage_report(storage_hand_t *storage, const char *name) {
+    static const char *const names[STORAGE_PHASE_CNT + 1] = {
+        "init   ", "config ", "kernel ", "modules", "total  "
+    };
+
+    /* Attribute everything up to now */
+    storage_phase(storage, storage->phase);
+
+    /* @note The in-tree printf only supports right-aligned fields */
+    printf("Storage I/O: %s\n"
+           "          requested      read xfers  BIOS retry      ms c.hit c.mis t.hit t.mis\n", name);
+    for(unsigned i = 0; i <= STORAGE_PHASE_CNT; i++) {
+        const storage_stats_t *stats = (i < STORAGE_PHASE_CNT) ? &storage->phase_stats[i] : &storage->stats;
+        printf("  %s %9u %9u %5u %5u %5u %7u %5u %5u %5u %5u\n", names[i],
+               stats->requested, stats->read, stats->xfers, stats->bios_calls,
+               stats->retries, (stats->ticks * 1000) / TIME_TICKS_PER_SECOND,
+               stats->cache_hits, stats->cache_misses, stats->track_hits, stats->track_misses);
+    }
+}
@@ -0,0 +1,309 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "io/ioport.h"
+#include "io/output.h"
+#include "mm/alloc.h"
+#include "pci/pci.h"
+#include "storage/virtio.h"
+#include "time/time.h"
+
+/* @note since we currently allow only a single device open at a time, having
+ * this statically declared should be fine. */
+static storage_virtio_data_t _virtio_data = { 0 };
+
+#define VIRTIO_TIMEOUT_CMD (5000) /**< Timeout for a request to complete, in ms */
+
+/** Keep the compiler from moving ring updates past device accesses */
+#define _virtio_barrier() asm volatile("" ::: "memory")
+
+static ssize_t _read(storage_hand_t *storage, void *buff, off_t offset, size_t size);
+static int     _virtio_setup(storage_virtio_data_t *vdata);
+
+int storage_virtio_init(storage_hand_t *storage, uint8_t index) {
+    memset(storage, 0, sizeof(storage_hand_t));
+    memset(&_virtio_data, 0, sizeof(_virtio_data));
+    _virtio_data.stats = &storage->stats;
+
+    pci_addr_t pci;
+    if(pci_find_device(VIRTIO_PCI_VENDOR, VIRTIO_PCI_DEVICE_BLK, index, &pci)) {
+        return -1;
+    }
+
+    uint32_t iobase = pci_bar(pci, VIRTIO_BAR);
+    if(!iobase) {
+        return -1;
+    }
+    pci_enable(pci, PCI_COMMAND_IO | PCI_COMMAND_MASTER);
+    _virtio_data.iobase = iobase;
+
+    if(_virtio_setup(&_virtio_data)) {
+        outb(VIRTIO_REG_STATUS(_virtio_data.iobase), VIRTIO_STATUS_FAILED);
+        printf("storage_virtio: Could not set up device\n");
+        return -1;
+    }
+
+    /* Only the first 2^32 sectors are usable regardless */
+    if(inl(VIRTIO_BLK_CFG_CAPACITY(_virtio_data.iobase) + 4)) {
+        _virtio_data.n_sectors = 0xFFFFFFFF;
+    } else {
+        _virtio_data.n_sectors = inl(VIRTIO_BLK_CFG_CAPACITY(_virtio_data.iobase));
+    }
+
+    /* @note Offsets are currently 32-bit signed, so only the first 2 GiB of the
+     * drive is accessible. */
+    uint64_t size = (uint64_t)_virtio_data.n_sectors * STORAGE_VIRTIO_SECTOR_SIZE;
+    if(size > INT_MAX) {
+        size = INT_MAX - (INT_MAX % STORAGE_VIRTIO_SECTOR_SIZE);
+    }
+    storage->size = (size_t)size;
+
+#if (DEBUG_STORAGE_VIRTIO)
+    printf("storage_virtio: Device at %04hx, %u sectors, queue size %hu, %hhu x %u byte segments\n",
+           _virtio_data.iobase, _virtio_data.n_sectors, _virtio_data.q_size,
+           _virtio_data.n_segs, _virtio_data.seg_size);
+#endif
+
+    storage->block_size = STORAGE_VIRTIO_SECTOR_SIZE;
+    storage->data       = &_virtio_data;
+    storage->read       = _read;
+
+    return 0;
+}
+
+/**
+ * @brief Negotiate features, and set up the request virtqueue
+ *
+ * @param vdata virtio storage data, with `iobase` populated
+ * @return int 0 on success, else < 0
+ */
+static int _virtio_setup(storage_virtio_data_t *vdata) {
+    uint16_t io = vdata->iobase;
+
+    outb(VIRTIO_REG_STATUS(io), 0);
+    outb(VIRTIO_REG_STATUS(io), VIRTIO_STATUS_ACKNOWLEDGE);
+    outb(VIRTIO_REG_STATUS(io), VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
+
+    uint32_t features = inl(VIRTIO_REG_DEVICE_FEATURES(io)) &
+                        (VIRTIO_BLK_F_SIZE_MAX | VIRTIO_BLK_F_SEG_MAX);
+    outl(VIRTIO_REG_GUEST_FEATURES(io), features);
+
+    /* Split each request's data into as few descriptors as the device allows */
+    uint32_t chunk = STORAGE_VIRTIO_CHUNK * STORAGE_VIRTIO_SECTOR_SIZE;
+    vdata->seg_size = chunk;
+    if(features & VIRTIO_BLK_F_SIZE_MAX) {
+        uint32_t size_max = inl(VIRTIO_BLK_CFG_SIZE_MAX(io)) & ~(STORAGE_VIRTIO_SECTOR_SIZE - 1);
+        if(size_max && (size_max < vdata->seg_size)) {
+            vdata->seg_size = size_max;
+        }
+    }
+    vdata->n_segs = (chunk + vdata->seg_size - 1) / vdata->seg_size;
+    if(vdata->n_segs > STORAGE_VIRTIO_MAX_SEGS) {
+        vdata->n_segs = STORAGE_VIRTIO_MAX_SEGS;
+    }
+    if(features & VIRTIO_BLK_F_SEG_MAX) {
+        uint32_t seg_max = inl(VIRTIO_BLK_CFG_SEG_MAX(io));
+        if(seg_max && (seg_max < vdata->n_segs)) {
+            vdata->n_segs = seg_max;
+        }
+    }
+
+    outw(VIRTIO_REG_QUEUE_SELECT(io), 0);
+    vdata->q_size = inw(VIRTIO_REG_QUEUE_SIZE(io));
+    /* Each request in flight owns a fixed run of descriptors: header, data
+     * segments, status */
+    if(vdata->q_size < (STORAGE_VIRTIO_INFLIGHT * (vdata->n_segs + 2))) {
+        return -1;
+    }
+
+    /* Legacy virtqueue layout: descriptor table and available ring, then the
+     * used ring on the next page boundary */
+    uint32_t align    = 1UL << VIRTIO_QUEUE_ALIGN;
+    uint32_t used_off = (sizeof(virtq_desc_t) * vdata->q_size) +
+                        sizeof(virtq_avail_t) + (sizeof(uint16_t) * (vdata->q_size + 1));
+    used_off = (used_off + align - 1) & ~(align - 1);
+    uint32_t q_bytes  = used_off + sizeof(virtq_used_t) +
+                        (sizeof(virtq_used_elem_t) * vdata->q_size) + sizeof(uint16_t);
+
+    void *queue = alloc(q_bytes, ALLOC_FLAG_ALIGN(VIRTIO_QUEUE_ALIGN));
+    vdata->reqs = alloc(sizeof(storage_virtio_req_t) * STORAGE_VIRTIO_INFLIGHT, 0);
+    if(!queue || !vdata->reqs) {
+        panic("Could not allocate virtqueue!");
+    }
+    memset(queue, 0, q_bytes);
+    memset(vdata->reqs, 0, sizeof(storage_virtio_req_t) * STORAGE_VIRTIO_INFLIGHT);
+
+    vdata->desc  = (virtq_desc_t *)queue;
+    vdata->avail = (virtq_avail_t *)((uintptr_t)queue + (sizeof(virtq_desc_t) * vdata->q_size));
+    vdata->used  = (volatile virtq_used_t *)((uintptr_t)queue + used_off);
+
+    /* Completion is polled */
+    vdata->avail->flags = VIRTQ_AVAIL_F_NO_INTERRUPT;
+
+    outl(VIRTIO_REG_QUEUE_PFN(io), (uintptr_t)queue >> VIRTIO_QUEUE_ALIGN);
+    outb(VIRTIO_REG_STATUS(io), VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER |
+                                VIRTIO_STATUS_DRIVER_OK);
+
+    return 0;
+}
+
+/**
+ * @brief Build the descriptor chain for a read request, and make it available
+ * to the device
+ *
+ * @param vdata virtio storage data
+ * @param slot Request slot to use, must not be busy
+ * @param buff Buffer to read into
+ * @param lba First sector to read
+ * @param count Number of sectors to read, at most `n_segs * seg_size` bytes
+ */
+static void _virtio_submit(storage_virtio_data_t *vdata, unsigned slot, void *buff, uint32_t lba, uint32_t count) {
+    storage_virtio_req_t *req  = &vdata->reqs[slot];
+    uint16_t              head = slot * (vdata->n_segs + 2);
+    uint16_t              d    = head;
+
+    vdata->stats->xfers++;
+    vdata->stats->read += count * STORAGE_VIRTIO_SECTOR_SIZE;
+
+    req->hdr.type     = VIRTIO_BLK_T_IN;
+    req->hdr.reserved = 0;
+    req->hdr.sector   = lba;
+    req->status       = 0xFF;
+    req->busy         = 1;
+
+    vdata->desc[d].addr  = (uintptr_t)&req->hdr;
+    vdata->desc[d].len   = sizeof(virtio_blk_req_t);
+    vdata->desc[d].flags = VIRTQ_DESC_F_NEXT;
+    vdata->desc[d].next  = d + 1;
+    d++;
+
+    /* Data segments point straight at the destination */
+    uint32_t left = count * STORAGE_VIRTIO_SECTOR_SIZE;
+    while(left) {
+        uint32_t seg = (left > vdata->seg_size) ? vdata->seg_size : left;
+
+        vdata->desc[d].addr  = (uintptr_t)buff;
+        vdata->desc[d].len   = seg;
+        vdata->desc[d].flags = VIRTQ_DESC_F_NEXT | VIRTQ_DESC_F_WRITE;
+        vdata->desc[d].next  = d + 1;
+        d++;
+
+        buff += seg;
+        left -= seg;
+    }
+
+    vdata->desc[d].addr  = (uintptr_t)&req->status;
+    vdata->desc[d].len   = 1;
+    vdata->desc[d].flags = VIRTQ_DESC_F_WRITE;
+    vdata->desc[d].next  = 0;
+
+    vdata->avail->ring[vdata->avail->idx % vdata->q_size] = head;
+    _virtio_barrier();
+    vdata->avail->idx++;
+}
+
+/**
+ * @brief Process completed requests in the used ring
+ *
+ * @param vdata virtio storage data
+ * @return int Number of requests that completed, or < 0 if any failed
+ */
+static int _virtio_reap(storage_virtio_data_t *vdata) {
+    int done = 0;
+    int err  = 0;
+
+    while(vdata->last_used != vdata->used->idx) {
+        _virtio_barrier();
+        uint32_t id = vdata->used->ring[vdata->last_used % vdata->q_size].id;
+        vdata->last_used++;
+
+        storage_virtio_req_t *req = &vdata->reqs[id / (vdata->n_segs + 2)];
+        if(req->status != VIRTIO_BLK_S_OK) {
+            vdata->stats->failures++;
+            err = 1;
+        }
+        req->busy = 0;
+        done++;
+    }
+
+    return err ? -1 : done;
+}
+
+static ssize_t _read(storage_hand_t *storage, void *buff, off_t offset, size_t size) {
+#if (DEBUG_STORAGE_VIRTIO)
+    printf("_virtio_read(..., %p, %5d, %4d)", buff, offset, size);
+#endif
+
+    storage_virtio_data_t *vdata = (storage_virtio_data_t *)storage->data;
+
+    if((offset % STORAGE_VIRTIO_SECTOR_SIZE) || (size % STORAGE_VIRTIO_SECTOR_SIZE)) {
+        /* Currently only support sector-aligned reads */
+        panic("Address or size not aligned to sector count!");
+    }
+    if(offset < 0) {
+        panic("Negative offset!");
+    }
+
+    uint32_t lba      = offset / STORAGE_VIRTIO_SECTOR_SIZE;
+    uint32_t count    = size   / STORAGE_VIRTIO_SECTOR_SIZE;
+    uint32_t max      = (vdata->n_segs * vdata->seg_size) / STORAGE_VIRTIO_SECTOR_SIZE;
+    unsigned inflight = 0;
+    int      err      = 0;
+
+    time_ticks_t timeout;
+    time_offset(&timeout, VIRTIO_TIMEOUT_CMD);
+
+    /* Keep up to STORAGE_VIRTIO_INFLIGHT requests queued, topping the queue up
+     * as requests complete. On error, stop submitting and drain what is
+     * outstanding, as the device may still be writing to it. */
+    while((count && !err) || inflight) {
+        unsigned submitted = 0;
+        for(unsigned slot = 0; (slot < STORAGE_VIRTIO_INFLIGHT) && count && !err; slot++) {
+            if(vdata->reqs[slot].busy) {
+                continue;
+            }
+            uint32_t run = (count > max) ? max : count;
+            _virtio_submit(vdata, slot, buff, lba, run);
+
+            buff  += run * STORAGE_VIRTIO_SECTOR_SIZE;
+            lba   += run;
+            count -= run;
+            submitted++;
+        }
+        if(submitted) {
+            _virtio_barrier();
+            outw(VIRTIO_REG_QUEUE_NOTIFY(vdata->iobase), 0);
+            inflight += submitted;
+        }
+
+        int done = _virtio_reap(vdata);
+        if(done < 0) {
+            err = 1;
+            /* Every busy flag of a completed request was cleared */
+            inflight = 0;
+            for(unsigned slot = 0; slot < STORAGE_VIRTIO_INFLIGHT; slot++) {
+                inflight += vdata->reqs[slot].busy;
+            }
+        } else if(done) {
+            inflight -= done;
+            time_offset(&timeout, VIRTIO_TIMEOUT_CMD);
+            status_working(WORKING_STATUS_WORKING);
+        } else if(time_ispast(&timeout)) {
+            /* Requests still owned by the device cannot be reused safely */
+            panic("virtio-blk request timed out!");
+        }
+    }
+
+    if(err) {
+#if (DEBUG_STORAGE_VIRTIO)
+        printf(" FAIL [failures: %u]\n", vdata->stats->failures);
+#endif
+        return -1;
+    }
+
+#if (DEBUG_STORAGE_VIRTIO)
+    printf(" OK\n");
+#endif
+
+    return (ssize_t)size;
+}
@@ -9,7 +9,7 @@ STAGE2      = $(S2_BUILDDIR)/stage2.bin
 S2_SRCDIR = src
 S2_INCDIR = inc
 
-S2_LDFLAGS = -T stage2.ld -melf_i386
+S2_LDFLAGS = -T stage2.ld -melf_i386 --gc-sections
 S2_CFLAGS  = -m32 -march=i386 -fno-pic \
 			 -I $(S2_INCDIR) \
 			 -nostdlib -nostdinc -ffreestanding -Wall -Wextra -Werror -Os \
@@ -0,0 +1,341 @@
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <errno.h>
+
+/*
+ * Serves an image file to LBoot's remote block driver (src/storage/remote.c)
+ * over a serial port, or over a QEMU serial socket (see `make emu-sock`). All
+ * fields are little-endian.
+ *
+ * Request, 14 bytes:
+ *   u8 magic (0xB1), u8 cmd, u16 seq, u32 offset, u32 size, u16 crc
+ * Response:
+ *   u8 magic (0xB2), u8 status, u16 seq, u32 size, payload[size], u16 crc
+ *
+ * CRCs are CRC-16-CCITT (XMODEM variant), over everything preceding them in
+ * the request or response. Requests failing their CRC are dropped, and
+ * retried by the client after a timeout.
+ */
+
+#define REMOTE_MAGIC_REQ  (0xB1)
+#define REMOTE_MAGIC_RESP (0xB2)
+
+#define REMOTE_CMD_INFO   (0x01) /**< Get image size, returned as a 32-bit payload */
+#define REMOTE_CMD_READ   (0x02) /**< Read size bytes starting at offset */
+
+#define REMOTE_REQ_SIZE   (14)
+#define REMOTE_RESP_SIZE  (8)
+#define REMOTE_MAX_XFER   (0x1000) /**< Must be at least that of the client */
+
+#define REMOTE_STATUS_OK     (0)
+#define REMOTE_STATUS_BADCMD (1) /**< Unknown command */
+#define REMOTE_STATUS_RANGE  (2) /**< Read outside of the image, or too large */
+#define REMOTE_STATUS_IOERR  (3) /**< Image could not be read */
+
+static int _verbose = 0;
+
+static void _usage(void);
+static int  _open_port(const char *path, speed_t baud);
+static int  _serve(int port, int image, off_t image_size);
+
+int main(int argc, char **argv) {
+    speed_t baud = B115200;
+
+    int opt;
+    while((opt = getopt(argc, argv, "b:v")) != -1) {
+        switch(opt) {
+            case 'b':
+                switch(strtol(optarg, NULL, 10)) {
+                    case 9600:   baud = B9600;   break;
+                    case 19200:  baud = B19200;  break;
+                    case 38400:  baud = B38400;  break;
+                    case 57600:  baud = B57600;  break;
+                    case 115200: baud = B115200; break;
+                    default:
+                        fprintf(stderr, "Unsupported baud rate `%s`\n", optarg);
+                        return 1;
+                }
+                break;
+            case 'v':
+                _verbose = 1;
+                break;
+            default:
+                _usage();
+                return 1;
+        }
+    }
+
+    if((argc - optind) != 2) {
+        _usage();
+        return 1;
+    }
+
+    int image = open(argv[optind + 1], O_RDONLY);
+    if(image < 0) {
+        fprintf(stderr, "Could not open image `%s`: %s\n", argv[optind + 1], strerror(errno));
+        return 1;
+    }
+
+    struct stat st;
+    if(fstat(image, &st) || (st.st_size > 0xFFFFFFFF)) {
+        fprintf(stderr, "Could not get size of image, or image too large\n");
+        return 1;
+    }
+
+    int port = _open_port(argv[optind], baud);
+    if(port < 0) {
+        return 1;
+    }
+
+    fprintf(stderr, "Serving `%s` (%ld bytes) on `%s`\n", argv[optind + 1], (long)st.st_size, argv[optind]);
+
+    int ret = _serve(port, image, st.st_size);
+
+    close(port);
+    close(image);
+
+    return ret;
+}
+
+static void _usage(void) {
+    fprintf(stderr, "USAGE:\n"
+                    "  block_server [-b baud] [-v] <serial device or socket> <image>\n");
+}
+
+/**
+ * @brief Open serial device in raw mode, or connect to a UNIX socket
+ *
+ * @param path Path to serial device or socket
+ * @param baud Baud rate, for serial devices
+ * @return int File descriptor, or < 0 on error
+ */
+static int _open_port(const char *path, speed_t baud) {
+    struct stat st;
+    if(stat(path, &st)) {
+        fprintf(stderr, "Could not find `%s`: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    if(S_ISSOCK(st.st_mode)) {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if((fd < 0) ||
+           connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+            fprintf(stderr, "Could not connect to `%s`: %s\n", path, strerror(errno));
+            return -1;
+        }
+
+        return fd;
+    }
+
+    int fd = open(path, O_RDWR | O_NOCTTY);
+    if(fd < 0) {
+        fprintf(stderr, "Could not open `%s`: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    struct termios tio;
+    if(tcgetattr(fd, &tio)) {
+        fprintf(stderr, "`%s` is not a serial device: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, baud);
+    cfsetospeed(&tio, baud);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN]  = 1;
+    tio.c_cc[VTIME] = 0;
+
+    if(tcsetattr(fd, TCSANOW, &tio)) {
+        fprintf(stderr, "Could not configure `%s`: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/**
+ * @brief Calculate CRC-16-CCITT (XMODEM variant) of input data
+ *
+ * @param crc CRC of any preceding data, or 0
+ * @param data Data to calculate CRC over
+ * @param len Number of bytes of data
+ * @return uint16_t Resulting CRC
+ */
+static uint16_t _crc16(uint16_t crc, const uint8_t *data, size_t len) {
+    for(size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)(data[i] << 8);
+
+        for(unsigned j = 0; j < 8; j++) {
+            if(crc & 0x8000) {
+                crc = (uint16_t)((crc << 1) ^ 0x1021);
+            } else {
+                crc = (uint16_t)(crc << 1);
+            }
+        }
+    }
+
+    return crc;
+}
+
+static uint16_t _get16(const uint8_t *b) {
+    return (uint16_t)(b[0] | (b[1] << 8));
+}
+
+static uint32_t _get32(const uint8_t *b) {
+    return (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+static void _put16(uint8_t *b, uint16_t val) {
+    b[0] = (uint8_t)val;
+    b[1] = (uint8_t)(val >> 8);
+}
+
+static void _put32(uint8_t *b, uint32_t val) {
+    _put16(b,     (uint16_t)val);
+    _put16(b + 2, (uint16_t)(val >> 16));
+}
+
+/**
+ * @brief Read exactly len bytes
+ *
+ * @return int 0 on success, else < 0 on error or end of file
+ */
+static int _read_full(int fd, uint8_t *buff, size_t len) {
+    while(len) {
+        ssize_t ret = read(fd, buff, len);
+        if(ret <= 0) {
+            if((ret < 0) && (errno == EINTR)) {
+                continue;
+            }
+            return -1;
+        }
+        buff += ret;
+        len  -= (size_t)ret;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Write exactly len bytes
+ *
+ * @return int 0 on success, else < 0
+ */
+static int _write_full(int fd, const uint8_t *buff, size_t len) {
+    while(len) {
+        ssize_t ret = write(fd, buff, len);
+        if(ret < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        buff += ret;
+        len  -= (size_t)ret;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Answer requests until the connection is closed
+ *
+ * @param port Serial port or socket
+ * @param image Image file
+ * @param image_size Size of image file
+ * @return int 0 if the connection was closed, else < 0 on error
+ */
+static int _serve(int port, int image, off_t image_size) {
+    uint8_t req[REMOTE_REQ_SIZE];
+    uint8_t resp[REMOTE_RESP_SIZE + REMOTE_MAX_XFER + 2];
+
+    for(;;) {
+        /* Skip anything that isn't the start of a request, e.g. console
+         * output or the tail of a corrupted request */
+        do {
+            if(_read_full(port, req, 1)) {
+                fprintf(stderr, "Connection closed\n");
+                return 0;
+            }
+        } while(req[0] != REMOTE_MAGIC_REQ);
+
+        if(_read_full(port, req + 1, REMOTE_REQ_SIZE - 1)) {
+            fprintf(stderr, "Connection closed\n");
+            return 0;
+        }
+
+        if(_get16(&req[12]) != _crc16(0, req, REMOTE_REQ_SIZE - 2)) {
+            if(_verbose) {
+                fprintf(stderr, "Dropping request with bad CRC\n");
+            }
+            continue;
+        }
+
+        uint8_t  cmd    = req[1];
+        uint16_t seq    = _get16(&req[2]);
+        uint32_t offset = _get32(&req[4]);
+        uint32_t size   = _get32(&req[8]);
+
+        uint8_t  status = REMOTE_STATUS_OK;
+        uint32_t len    = 0;
+        uint8_t *data   = &resp[REMOTE_RESP_SIZE];
+
+        switch(cmd) {
+            case REMOTE_CMD_INFO:
+                if(_verbose) {
+                    fprintf(stderr, "[%5hu] INFO\n", seq);
+                }
+                _put32(data, (uint32_t)image_size);
+                len = 4;
+                break;
+            case REMOTE_CMD_READ:
+                if(_verbose) {
+                    fprintf(stderr, "[%5hu] READ %08x + %u\n", seq, offset, size);
+                }
+                if((size > REMOTE_MAX_XFER) ||
+                   ((off_t)offset + (off_t)size > image_size)) {
+                    status = REMOTE_STATUS_RANGE;
+                } else if(pread(image, data, size, (off_t)offset) != (ssize_t)size) {
+                    status = REMOTE_STATUS_IOERR;
+                } else {
+                    len = size;
+                }
+                break;
+            default:
+                status = REMOTE_STATUS_BADCMD;
+                break;
+        }
+
+        if(status && _verbose) {
+            fprintf(stderr, "[%5hu] Failed, status %u\n", seq, status);
+        }
+
+        resp[0] = REMOTE_MAGIC_RESP;
+        resp[1] = status;
+        _put16(&resp[2], seq);
+        _put32(&resp[4], len);
+        _put16(&data[len], _crc16(0, resp, REMOTE_RESP_SIZE + len));
+
+        if(_write_full(port, resp, REMOTE_RESP_SIZE + len + 2)) {
+            fprintf(stderr, "Could not write response: %s\n", strerror(errno));
+            return -1;
+        }
+    }
+}
+